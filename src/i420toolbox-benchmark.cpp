@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2019  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "i420toolbox-kernels.hpp"
+
+#include <libyuv.h>
+#include <libyuv/video_common.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * This function runs kernel once to warm up the caches and then the given
+ * number of times, and prints the mean time per frame (i.e., the latency)
+ * together with the bandwidth for the given number of bytes per frame.
+ */
+void benchmark(const std::string &name, uint32_t iterations, uint64_t bytes, const std::function<void()> &kernel) {
+    kernel();
+    const auto START{std::chrono::steady_clock::now()};
+    for (uint32_t i{0}; i < iterations; i++) {
+        kernel();
+    }
+    const std::chrono::duration<double, std::milli> DURATION{std::chrono::steady_clock::now() - START};
+    const double MS_PER_FRAME{DURATION.count() / iterations};
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << MS_PER_FRAME << " ms/frame" << std::setw(10) << std::setprecision(0)
+              << static_cast<double>(bytes) / (MS_PER_FRAME * 1000.0) << " MB/s" << std::endl;
+}
+
+int32_t main(int32_t argc, char **argv) {
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " times the per-pixel kernels of i420toolbox on synthetic frames." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--width=<width>] [--height=<height>] [--iterations=<iterations>]" << std::endl;
+        std::cerr << "         --width:      width of the synthetic frames (default: 1920)" << std::endl;
+        std::cerr << "         --height:     height of the synthetic frames (default: 1080)" << std::endl;
+        std::cerr << "         --iterations: number of timed runs per kernel (default: 100)" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --width=1280 --height=720" << std::endl;
+        return 1;
+    }
+    const uint32_t WIDTH{(commandlineArguments.count("width") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["width"])) & ~1u : 1920u};
+    const uint32_t HEIGHT{(commandlineArguments.count("height") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["height"])) & ~1u : 1080u};
+    const uint32_t ITERATIONS{(commandlineArguments.count("iterations") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["iterations"])) : 100u};
+    const uint32_t AREA{WIDTH * HEIGHT};
+    std::cout << "Frames of " << WIDTH << "x" << HEIGHT << ", " << ITERATIONS << " iterations; MB/s refer to the bytes read and written per frame by the path in i420toolbox." << std::endl;
+
+    // The I420 output of all conversions.
+    std::vector<uint8_t> i420(AREA * 3/2);
+    uint8_t *dstY{i420.data()};
+    uint8_t *dstU{dstY + AREA};
+    uint8_t *dstV{dstU + AREA/4};
+
+    {
+        // 16 bit input is converted to 8 bit I420 in one pass while cropping (as in i420toolbox) or first
+        // into an 8 bit copy of the whole frame that is cropped into I420 afterwards.
+        std::vector<uint16_t> frame16(AREA * 3/2);
+        for (uint32_t i{0}; i < frame16.size(); i++) {
+            frame16[i] = static_cast<uint16_t>(((i * 7) & 0x3ff) << 6);
+        }
+        std::vector<uint8_t> frame8(AREA * 3/2);
+        const uint64_t BYTES{AREA * 3ull + AREA * 3ull / 2};
+
+        benchmark("p010 fused downconversion", ITERATIONS, BYTES, [&]() {
+            convert16ToI420(frame16.data(), WIDTH, HEIGHT, true, 256, 0, 0, WIDTH, HEIGHT, dstY, WIDTH, dstU, WIDTH/2, dstV, WIDTH/2);
+        });
+        benchmark("p010 separate downconversion", ITERATIONS, BYTES, [&]() {
+            libyuv::Convert16To8Plane(frame16.data(), WIDTH, frame8.data(), WIDTH, 256, WIDTH, HEIGHT * 3/2);
+            libyuv::NV12ToI420(frame8.data(), WIDTH, frame8.data() + AREA, WIDTH, dstY, WIDTH, dstU, WIDTH/2, dstV, WIDTH/2, WIDTH, HEIGHT);
+        });
+
+        for (uint32_t i{0}; i < frame16.size(); i++) {
+            frame16[i] = static_cast<uint16_t>((i * 7) & 0x3ff);
+        }
+        benchmark("i010 fused downconversion", ITERATIONS, BYTES, [&]() {
+            convert16ToI420(frame16.data(), WIDTH, HEIGHT, false, 16384, 0, 0, WIDTH, HEIGHT, dstY, WIDTH, dstU, WIDTH/2, dstV, WIDTH/2);
+        });
+        benchmark("i010 separate downconversion", ITERATIONS, BYTES, [&]() {
+            libyuv::Convert16To8Plane(frame16.data(), WIDTH, frame8.data(), WIDTH, 16384, WIDTH, HEIGHT * 3/2);
+            libyuv::I420Copy(frame8.data(), WIDTH, frame8.data() + AREA, WIDTH/2, frame8.data() + AREA + AREA/4, WIDTH/2,
+                             dstY, WIDTH, dstU, WIDTH/2, dstV, WIDTH/2, WIDTH, HEIGHT);
+        });
+    }
+
+    {
+        // Rotating by 90 degrees in ConvertToI420 (as in i420toolbox) uses libyuv's tiled transpose; it is compared
+        // with converting without rotation and with rotating pixel by pixel like a consumer would do it.
+        std::vector<uint8_t> frame(AREA * 3/2);
+        for (uint32_t i{0}; i < frame.size(); i++) {
+            frame[i] = static_cast<uint8_t>(i * 7);
+        }
+        const uint64_t BYTES{AREA * 3ull};
+        auto rotate = [&](libyuv::RotationMode mode) {
+            const uint32_t STRIDE{(libyuv::kRotate0 == mode) ? WIDTH : HEIGHT};
+            libyuv::ConvertToI420(frame.data(), frame.size(), dstY, STRIDE, dstU, STRIDE/2, dstV, STRIDE/2,
+                                  0, 0, WIDTH, HEIGHT, WIDTH, HEIGHT, mode, FOURCC('I', '4', '2', '0'));
+        };
+
+        benchmark("i420 rotate 0 degrees", ITERATIONS, BYTES, [&]() { rotate(libyuv::kRotate0); });
+        benchmark("i420 rotate 90 degrees (tiled)", ITERATIONS, BYTES, [&]() { rotate(libyuv::kRotate90); });
+        benchmark("i420 rotate 270 degrees (tiled)", ITERATIONS, BYTES, [&]() { rotate(libyuv::kRotate270); });
+        benchmark("i420 rotate 90 degrees (per pixel)", ITERATIONS, BYTES, [&]() {
+            const uint8_t *planes[3]{frame.data(), frame.data() + AREA, frame.data() + AREA + AREA/4};
+            uint8_t *rotated[3]{dstY, dstU, dstV};
+            for (uint32_t plane{0}; plane < 3; plane++) {
+                const uint32_t W{(0 == plane) ? WIDTH : WIDTH/2};
+                const uint32_t H{(0 == plane) ? HEIGHT : HEIGHT/2};
+                for (uint32_t y{0}; y < H; y++) {
+                    for (uint32_t x{0}; x < W; x++) {
+                        rotated[plane][x * H + (H - 1 - y)] = planes[plane][y * W + x];
+                    }
+                }
+            }
+        });
+    }
+
+    {
+        // The temporal filter counts the moving Y values against the history and then filters all planes with it
+        // (reading and writing image and history) or only copies them into the history when it is bypassed.
+        std::vector<uint8_t> frame(AREA * 3/2);
+        std::vector<uint8_t> history(AREA * 3/2);
+        for (uint32_t i{0}; i < frame.size(); i++) {
+            frame[i] = static_cast<uint8_t>(128 + (i * 7) % 9);
+            history[i] = static_cast<uint8_t>(128 + (i * 5) % 9);
+        }
+        const DenoiseRamp RAMP{computeDenoiseRamp(128, 16)};
+        auto denoise = [&](bool bypass) {
+            countMoving(frame.data(), WIDTH, WIDTH, HEIGHT, history.data(), 16);
+            denoisePlane(frame.data(), WIDTH, WIDTH, HEIGHT, history.data(), RAMP, bypass);
+            denoisePlane(frame.data() + AREA, WIDTH/2, WIDTH/2, HEIGHT/2, history.data() + AREA, RAMP, bypass);
+            denoisePlane(frame.data() + AREA + AREA/4, WIDTH/2, WIDTH/2, HEIGHT/2, history.data() + AREA + AREA/4, RAMP, bypass);
+        };
+
+        benchmark("denoise", ITERATIONS, AREA * 2ull + AREA * 6ull, [&]() { denoise(false); });
+        benchmark("denoise bypassed", ITERATIONS, AREA * 2ull + AREA * 3ull, [&]() { denoise(true); });
+    }
+
+    return 0;
+}
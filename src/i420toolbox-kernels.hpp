@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2019  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef I420TOOLBOX_KERNELS_HPP
+#define I420TOOLBOX_KERNELS_HPP
+
+// Per-pixel kernels of i420toolbox that are shared with i420toolbox-benchmark.
+
+#include <libyuv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * This function crops an I420-like image with 16 bits per sample, which is
+ * either planar (I010, I016) or semi-planar (P010, P016), and converts it to
+ * 8 bits per sample into the given I420 planes in one pass.
+ */
+inline void convert16ToI420(const uint16_t *src, uint32_t width, uint32_t height, bool semiPlanar, int scale,
+                            uint32_t cropX, uint32_t cropY, uint32_t cropWidth, uint32_t cropHeight,
+                            uint8_t *dstY, uint32_t strideY, uint8_t *dstU, uint32_t strideU, uint8_t *dstV, uint32_t strideV) {
+    libyuv::Convert16To8Plane(src + cropY * width + cropX, width, dstY, strideY, scale, cropWidth, cropHeight);
+
+    const uint16_t *chroma{src + width * height};
+    if (semiPlanar) {
+        // The interleaved chroma is downconverted in pieces of a row into a buffer that stays in the cache and split
+        // from there, so that both steps use libyuv's vectorized rows.
+        uint8_t uv[4096];
+        constexpr uint32_t PAIRS{sizeof(uv) / 2};
+        for (uint32_t row{0}; row < cropHeight/2; row++) {
+            const uint16_t *src16{chroma + (cropY/2 + row) * width + (cropX/2) * 2};
+            for (uint32_t x{0}; x < cropWidth/2; x += PAIRS) {
+                const uint32_t COUNT{std::min(PAIRS, cropWidth/2 - x)};
+                libyuv::Convert16To8Plane(src16 + 2 * x, 0, uv, 0, scale, static_cast<int>(2 * COUNT), 1);
+                libyuv::SplitUVPlane(uv, 0, dstU + row * strideU + x, 0, dstV + row * strideV + x, 0, static_cast<int>(COUNT), 1);
+            }
+        }
+    }
+    else {
+        const uint32_t OFFSET{(cropY/2) * (width/2) + cropX/2};
+        libyuv::Convert16To8Plane(chroma + OFFSET, width/2, dstU, strideU, scale, cropWidth/2, cropHeight/2);
+        libyuv::Convert16To8Plane(chroma + (width/2) * (height/2) + OFFSET, width/2, dstV, strideV, scale, cropWidth/2, cropHeight/2);
+    }
+}
+
+/**
+ * Blend of denoisePlane: the weight of a new value (in 1/256) starts at weight
+ * for static values and rises by slope (in 1/65536) per step of the difference
+ * from its history value, so that differences of threshold and more are taken
+ * over completely to keep moving edges sharp.
+ */
+struct DenoiseRamp {
+    uint16_t weight;
+    uint16_t slope;
+};
+
+inline DenoiseRamp computeDenoiseRamp(uint32_t weight, uint32_t threshold) {
+    return DenoiseRamp{static_cast<uint16_t>(weight), static_cast<uint16_t>(std::min(((256 - weight) * 256 + threshold - 1) / threshold, 65535u))};
+}
+
+/**
+ * @return Value blended into its history value with the given ramp; the
+ * vectorized paths of denoisePlane compute exactly the same in 16 bit lanes.
+ */
+inline uint8_t denoiseValue(uint8_t value, uint8_t history, const DenoiseRamp &ramp) {
+    const uint32_t MAGNITUDE{static_cast<uint32_t>((value > history) ? value - history : history - value)};
+    const uint32_t W{std::min(ramp.weight + ((MAGNITUDE * ramp.slope) >> 8), 256u)};
+    const uint32_t CORRECTION{(MAGNITUDE * W + 128) >> 8};
+    return static_cast<uint8_t>((value >= history) ? history + CORRECTION : history - CORRECTION);
+}
+
+/**
+ * @return Number of values of the given region of a plane that differ from
+ * their history values (stored contiguously) by threshold or more.
+ */
+inline uint32_t countMoving(const uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, const uint8_t *history, uint32_t threshold) {
+    uint32_t moving{0};
+    for (uint32_t row{0}; row < height; row++) {
+        const uint8_t *p{plane + row * stride};
+        const uint8_t *h{history + row * width};
+        for (uint32_t x{0}; x < width; x++) {
+            moving += (static_cast<uint32_t>(std::abs(p[x] - h[x])) >= threshold) ? 1 : 0;
+        }
+    }
+    return moving;
+}
+
+/**
+ * This function filters all values of the given region of a plane recursively
+ * with their history values (stored contiguously) using denoiseValue, 16 values
+ * at a time with SSE2 or NEON, and stores the results in both; with bypass, the
+ * plane is left unchanged and only copied to the history.
+ */
+inline void denoisePlane(uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, uint8_t *history, const DenoiseRamp &ramp, bool bypass) {
+    for (uint32_t row{0}; row < height; row++) {
+        uint8_t *p{plane + row * stride};
+        uint8_t *h{history + row * width};
+        if (bypass) {
+            std::memcpy(h, p, width);
+            continue;
+        }
+        uint32_t x{0};
+#if defined(__SSE2__)
+        // SSE2 has no unsigned 16 bit minimum, so min(a, 256) is computed as a - max(a - 256, 0).
+        const __m128i WEIGHT{_mm_set1_epi16(static_cast<int16_t>(ramp.weight))};
+        const __m128i SLOPE{_mm_set1_epi16(static_cast<int16_t>(ramp.slope))};
+        const __m128i MAX_WEIGHT{_mm_set1_epi16(256)};
+        const __m128i HALF{_mm_set1_epi16(128)};
+        const __m128i ZERO{_mm_setzero_si128()};
+        auto correction = [&](const __m128i &magnitude) {
+            const __m128i SUM{_mm_adds_epu16(WEIGHT, _mm_mulhi_epu16(_mm_slli_epi16(magnitude, 8), SLOPE))};
+            const __m128i W{_mm_sub_epi16(SUM, _mm_subs_epu16(SUM, MAX_WEIGHT))};
+            return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(magnitude, W), HALF), 8);
+        };
+        for (; x + 16 <= width; x += 16) {
+            const __m128i P{_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x))};
+            const __m128i H{_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + x))};
+            const __m128i MAGNITUDE{_mm_or_si128(_mm_subs_epu8(P, H), _mm_subs_epu8(H, P))};
+            const __m128i CORRECTION{_mm_packus_epi16(correction(_mm_unpacklo_epi8(MAGNITUDE, ZERO)), correction(_mm_unpackhi_epi8(MAGNITUDE, ZERO)))};
+            const __m128i UP{_mm_cmpeq_epi8(_mm_max_epu8(P, H), P)};
+            const __m128i RESULT{_mm_or_si128(_mm_and_si128(UP, _mm_adds_epu8(H, CORRECTION)), _mm_andnot_si128(UP, _mm_subs_epu8(H, CORRECTION)))};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), RESULT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(h + x), RESULT);
+        }
+#elif defined(__ARM_NEON)
+        const uint16x8_t WEIGHT{vdupq_n_u16(ramp.weight)};
+        const uint16x8_t MAX_WEIGHT{vdupq_n_u16(256)};
+        auto correction = [&](const uint8x8_t &magnitude) {
+            const uint16x8_t MAGNITUDE{vmovl_u8(magnitude)};
+            const uint16x8_t RAMP{vcombine_u16(vqshrn_n_u32(vmull_n_u16(vget_low_u16(MAGNITUDE), ramp.slope), 8),
+                                               vqshrn_n_u32(vmull_n_u16(vget_high_u16(MAGNITUDE), ramp.slope), 8))};
+            const uint16x8_t W{vminq_u16(vqaddq_u16(WEIGHT, RAMP), MAX_WEIGHT)};
+            return vrshrn_n_u16(vmulq_u16(MAGNITUDE, W), 8);
+        };
+        for (; x + 16 <= width; x += 16) {
+            const uint8x16_t P{vld1q_u8(p + x)};
+            const uint8x16_t H{vld1q_u8(h + x)};
+            const uint8x16_t MAGNITUDE{vabdq_u8(P, H)};
+            const uint8x16_t CORRECTION{vcombine_u8(correction(vget_low_u8(MAGNITUDE)), correction(vget_high_u8(MAGNITUDE)))};
+            const uint8x16_t RESULT{vbslq_u8(vcgeq_u8(P, H), vqaddq_u8(H, CORRECTION), vqsubq_u8(H, CORRECTION))};
+            vst1q_u8(p + x, RESULT);
+            vst1q_u8(h + x, RESULT);
+        }
+#endif
+        for (; x < width; x++) {
+            h[x] = p[x] = denoiseValue(p[x], h[x], ramp);
+        }
+    }
+}
+
+#endif
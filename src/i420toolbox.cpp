@@ -16,17 +16,1301 @@
  */
 
 #include "cluon-complete.hpp"
+#include "i420toolbox-kernels.hpp"
 
 #include <libyuv.h>
 #include <libyuv/video_common.h>
 #include <X11/Xlib.h>
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
+/**
+ * Layout of the shared memory area created in synchronization mode (--sync):
+ * SyncHeader, followed by one SyncEntry per input, followed by the frames at
+ * the offsets given in their entries. The sample time stamp of the shared
+ * memory area itself is the time stamp of the frame from the first input.
+ */
+struct SyncHeader {
+    uint32_t numberOfEntries;
+    uint32_t toleranceInMicroseconds;
+    int64_t timeStamp;
+};
+struct SyncEntry {
+    uint32_t offset;
+    uint32_t size;
+    int64_t timeStamp;
+};
+
+/**
+ * Ring buffer holding the latest frames of one input to be synchronized.
+ */
+struct SyncInput {
+    std::unique_ptr<cluon::SharedMemory> sharedMemory{nullptr};
+    std::vector<std::vector<char>> frames{};
+    std::vector<int64_t> timeStamps{};
+    uint32_t next{0};
+};
+
+struct SyncState {
+    std::mutex mutex{};
+    std::condition_variable newFrame{};
+    std::vector<SyncInput> inputs{};
+};
+
+int32_t synchronize(std::map<std::string, std::string> &commandlineArguments) {
+    int32_t retCode{1};
+    const std::string OUT{commandlineArguments["out"]};
+    const int64_t TOLERANCE{(commandlineArguments.count("sync.tolerance") != 0) ? static_cast<int64_t>(std::stoi(commandlineArguments["sync.tolerance"])) * 1000 : 10 * 1000};
+    const uint32_t DEPTH{(commandlineArguments.count("sync.depth") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["sync.depth"])) : 4u};
+
+    std::vector<std::string> names{stringtoolbox::split(commandlineArguments["sync"], ',')};
+    if ( (2 > names.size()) || (0 == DEPTH) ) {
+        std::cerr << "[i420toolbox]: --sync requires at least two shared memory areas and --sync.depth must be larger than 0." << std::endl;
+        return retCode;
+    }
+
+    auto state = std::make_shared<SyncState>();
+    uint32_t offset{static_cast<uint32_t>(sizeof(SyncHeader) + names.size() * sizeof(SyncEntry))};
+    std::vector<SyncEntry> entries;
+    for (auto name : names) {
+        SyncInput input;
+        input.sharedMemory.reset(new cluon::SharedMemory{name});
+        if (input.sharedMemory && input.sharedMemory->valid()) {
+            std::clog << "[i420toolbox]: Attached to '" << input.sharedMemory->name() << "' (" << input.sharedMemory->size() << " bytes)." << std::endl;
+        }
+        else {
+            std::cerr << "[i420toolbox]: Failed to attach to shared memory '" << name << "'." << std::endl;
+            return retCode;
+        }
+        input.frames.resize(DEPTH, std::vector<char>(input.sharedMemory->size()));
+        input.timeStamps.resize(DEPTH, 0);
+
+        // Keep every frame 64 bytes aligned in the grouped output.
+        offset = (offset + 63u) & ~63u;
+        entries.push_back(SyncEntry{offset, input.sharedMemory->size(), 0});
+        offset += input.sharedMemory->size();
+        state->inputs.push_back(std::move(input));
+    }
+
+    std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT{new cluon::SharedMemory{OUT, offset}};
+    if (sharedMemoryOUT && sharedMemoryOUT->valid()) {
+        std::clog << "[i420toolbox]: Created shared memory " << OUT << " (" << sharedMemoryOUT->size() << " bytes) for " << names.size() << " synchronized frames." << std::endl;
+    }
+    else {
+        std::cerr << "[i420toolbox]: Failed to create shared memory for synchronized frames." << std::endl;
+        return retCode;
+    }
+
+    // Each input is waited for in its own thread; the threads are detached as
+    // they block in wait() until their producer sends the next frame.
+    for (uint32_t i{0}; i < state->inputs.size(); i++) {
+        std::thread([state, i, DEPTH]() {
+            SyncInput &input = state->inputs[i];
+            while (!cluon::TerminateHandler::instance().isTerminated) {
+                input.sharedMemory->wait();
+                {
+                    std::lock_guard<std::mutex> lck(state->mutex);
+                    input.sharedMemory->lock();
+                    {
+                        auto r = input.sharedMemory->getTimeStamp();
+                        input.timeStamps[input.next] = cluon::time::toMicroseconds(r.first ? r.second : cluon::time::now());
+                        std::memcpy(input.frames[input.next].data(), input.sharedMemory->data(), input.sharedMemory->size());
+                        input.next = (input.next + 1) % DEPTH;
+                    }
+                    input.sharedMemory->unlock();
+                }
+                state->newFrame.notify_one();
+            }
+        }).detach();
+    }
+
+    int64_t lastTimeStamp{0};
+    std::vector<uint32_t> match(names.size(), 0);
+    while (!cluon::TerminateHandler::instance().isTerminated) {
+        std::unique_lock<std::mutex> lck(state->mutex);
+        state->newFrame.wait_for(lck, std::chrono::milliseconds(100));
+
+        // Find the newest frame from the first input that has a frame within the tolerance in every other input.
+        bool found{false};
+        const SyncInput &first = state->inputs[0];
+        for (uint32_t j{0}; (j < DEPTH) && !found; j++) {
+            match[0] = (first.next + DEPTH - 1 - j) % DEPTH;
+            const int64_t REFERENCE{first.timeStamps[match[0]]};
+            if (REFERENCE <= lastTimeStamp) {
+                continue;
+            }
+            found = true;
+            for (uint32_t i{1}; (i < state->inputs.size()) && found; i++) {
+                const SyncInput &other = state->inputs[i];
+                int64_t bestDelta{-1};
+                for (uint32_t k{0}; k < DEPTH; k++) {
+                    const int64_t DELTA{std::llabs(other.timeStamps[k] - REFERENCE)};
+                    if ( (0 != other.timeStamps[k]) && ((0 > bestDelta) || (DELTA < bestDelta)) ) {
+                        bestDelta = DELTA;
+                        match[i] = k;
+                    }
+                }
+                found = (0 <= bestDelta) && (bestDelta <= TOLERANCE);
+            }
+        }
+
+        if (found) {
+            lastTimeStamp = first.timeStamps[match[0]];
+            sharedMemoryOUT->lock();
+            sharedMemoryOUT->setTimeStamp(cluon::time::fromMicroseconds(lastTimeStamp));
+            {
+                SyncHeader header{static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(TOLERANCE), lastTimeStamp};
+                std::memcpy(sharedMemoryOUT->data(), &header, sizeof(SyncHeader));
+                for (uint32_t i{0}; i < entries.size(); i++) {
+                    const SyncInput &input = state->inputs[i];
+                    entries[i].timeStamp = input.timeStamps[match[i]];
+                    std::memcpy(sharedMemoryOUT->data() + sizeof(SyncHeader) + i * sizeof(SyncEntry), &entries[i], sizeof(SyncEntry));
+                    std::memcpy(sharedMemoryOUT->data() + entries[i].offset, input.frames[match[i]].data(), entries[i].size);
+                }
+            }
+            sharedMemoryOUT->unlock();
+            lck.unlock();
+
+            // Notify listeners.
+            sharedMemoryOUT->notifyAll();
+        }
+    }
+    retCode = 0;
+    return retCode;
+}
+
+/**
+ * @return Values from a comma-separated list.
+ */
+std::vector<float> toFloats(const std::string &str) {
+    std::vector<float> values;
+    std::stringstream sstr{str};
+    std::string value;
+    while (std::getline(sstr, value, ',')) {
+        values.push_back(std::stof(value));
+    }
+    return values;
+}
+
+/**
+ * Layout of the shared memory area created for the tensor output (--out.tensor):
+ * TensorHeader, followed by the tensor data starting at dataOffset (aligned to
+ * 64 bytes). Channels are in RGB order and each value is (value/255 - mean)/stddev;
+ * int8 values need to be multiplied by scale to obtain that normalized value.
+ *
+ * Batched tensors (batch > 1) are shared by several i420toolbox instances that
+ * each fill one slot. They are double-buffered: the slots are filled in one
+ * bank of bankSize bytes while the other bank, readyBank, holds the batch that
+ * was published last with the slots given in the bit mask validSlots.
+ */
+struct TensorHeader {
+    uint32_t dataType;
+    uint32_t layout;
+    uint32_t batch;
+    uint32_t channels;
+    uint32_t height;
+    uint32_t width;
+    uint32_t dataOffset;
+    float scale;
+    float mean[3];
+    float stddev[3];
+    uint32_t bankSize;
+    uint32_t readyBank;
+    uint32_t validSlots;
+    uint32_t filledSlots;
+    uint64_t cycle;
+    int64_t cycleStart;
+};
+enum TensorDataType : uint32_t { TENSOR_FLOAT32 = 0, TENSOR_FLOAT16 = 1, TENSOR_INT8 = 2 };
+enum TensorLayout : uint32_t { TENSOR_CHW = 0, TENSOR_HWC = 1 };
+
+/**
+ * Layout of the shared memory area created for the pyramid output (--out.pyramid):
+ * PyramidHeader with a directory of levels, followed by the levels (each aligned
+ * to 64 bytes and located at offset from the begin of the shared memory area).
+ * Level 0 is the output image; every further level has half the width and height
+ * of the previous one and is reduced from it with a 2x2 box filter. All levels
+ * are either Y planes or I420 images.
+ */
+struct PyramidLevel {
+    uint32_t width;
+    uint32_t height;
+    uint32_t offset;
+    uint32_t size;
+};
+constexpr uint32_t PYRAMID_MAX_LEVELS{8};
+struct PyramidHeader {
+    uint32_t format;
+    uint32_t levels;
+    PyramidLevel level[PYRAMID_MAX_LEVELS];
+};
+enum PyramidFormat : uint32_t { PYRAMID_Y = 0, PYRAMID_I420 = 1 };
+
+/**
+ * Layout of the shared memory area created for the integral image output
+ * (--out.integral): IntegralHeader, followed by the summed-area table of the Y
+ * plane at sumOffset and, if requested, the one of the squared Y values at
+ * squaredSumOffset (0 otherwise); both are aligned to 64 bytes. The tables have
+ * (width + 1) x (height + 1) entries of 32 bits (sums) or 64 bits (squared
+ * sums); their first row and column are 0.
+ */
+struct IntegralHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t sumOffset;
+    uint32_t squaredSumOffset;
+};
+
+/**
+ * This function computes the summed-area table of the given plane into sum and,
+ * unless squaredSum is nullptr, the one of the squared values into squaredSum.
+ */
+void integralImage(const uint8_t *src, uint32_t stride, uint32_t width, uint32_t height, uint32_t *sum, uint64_t *squaredSum) {
+    const uint32_t SUM_STRIDE{width + 1};
+    std::fill(sum, sum + SUM_STRIDE, 0u);
+    if (nullptr != squaredSum) {
+        std::fill(squaredSum, squaredSum + SUM_STRIDE, 0u);
+    }
+    for (uint32_t row{0}; row < height; row++) {
+        const uint8_t *srcRow{src + row * stride};
+        // The running sum along the row is serial; adding the row above is a separate loop that is vectorized.
+        const uint32_t *sumAbove{sum + row * SUM_STRIDE};
+        uint32_t *sumRow{sum + (row + 1) * SUM_STRIDE};
+        uint32_t rowSum{0};
+        sumRow[0] = 0;
+        for (uint32_t x{0}; x < width; x++) {
+            rowSum += srcRow[x];
+            sumRow[x + 1] = rowSum;
+        }
+        for (uint32_t x{1}; x <= width; x++) {
+            sumRow[x] += sumAbove[x];
+        }
+        if (nullptr != squaredSum) {
+            const uint64_t *squaredSumAbove{squaredSum + row * SUM_STRIDE};
+            uint64_t *squaredSumRow{squaredSum + (row + 1) * SUM_STRIDE};
+            uint64_t rowSquaredSum{0};
+            squaredSumRow[0] = 0;
+            for (uint32_t x{0}; x < width; x++) {
+                rowSquaredSum += static_cast<uint32_t>(srcRow[x]) * srcRow[x];
+                squaredSumRow[x + 1] = rowSquaredSum;
+            }
+            for (uint32_t x{1}; x <= width; x++) {
+                squaredSumRow[x] += squaredSumAbove[x];
+            }
+        }
+    }
+}
+
+/**
+ * Layout of the shared memory area created for the statistics output
+ * (--out.stats): StatsHeader with the statistics of the Y plane (without the
+ * padding in fit mode), followed by the mean Y value of each tile as float in
+ * row-major order when tiles were requested. underexposed and overexposed are
+ * the fractions of Y values at or below and at or above the clipping limits.
+ */
+struct StatsHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t minimum;
+    uint32_t maximum;
+    float mean;
+    float underexposed;
+    float overexposed;
+    uint32_t tileColumns;
+    uint32_t tileRows;
+    uint32_t histogram[256];
+};
+
+/**
+ * This function accumulates the histogram of the given plane and the sums of
+ * its values in columns x rows equally sized tiles.
+ */
+void lumaStatistics(const uint8_t *src, uint32_t stride, uint32_t width, uint32_t height, uint32_t columns, uint32_t rows, uint32_t *histogram, uint64_t *tileSums) {
+    // Four partial histograms avoid stalls when neighboring pixels have the same value.
+    uint32_t partial[4][256]{};
+    for (uint32_t row{0}; row < height; row++) {
+        const uint8_t *srcRow{src + row * stride};
+        uint32_t x{0};
+        for (; x + 4 <= width; x += 4) {
+            partial[0][srcRow[x]]++;
+            partial[1][srcRow[x + 1]]++;
+            partial[2][srcRow[x + 2]]++;
+            partial[3][srcRow[x + 3]]++;
+        }
+        for (; x < width; x++) {
+            partial[0][srcRow[x]]++;
+        }
+        if (0 < columns * rows) {
+            uint64_t *tileRow{tileSums + (row * rows / height) * columns};
+            for (uint32_t column{0}; column < columns; column++) {
+                uint32_t sum{0};
+                for (uint32_t i{column * width / columns}; i < (column + 1) * width / columns; i++) {
+                    sum += srcRow[i];
+                }
+                tileRow[column] += sum;
+            }
+        }
+    }
+    for (uint32_t i{0}; i < 256; i++) {
+        histogram[i] = partial[0][i] + partial[1][i] + partial[2][i] + partial[3][i];
+    }
+}
+
+/**
+ * Layout of the shared memory area created for the motion output
+ * (--out.motion): MotionHeader followed by one MotionVector per block of
+ * MOTION_BLOCK x MOTION_BLOCK pixels of the Y plane (without the padding in fit
+ * mode) in row-major order. A block of the current frame at (x, y) matches the
+ * block of the previous frame at (x + dx, y + dy) with the given SAD.
+ */
+struct MotionHeader {
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t blockSize;
+    uint32_t range;
+};
+struct MotionVector {
+    int8_t dx;
+    int8_t dy;
+    uint16_t sad;
+};
+constexpr uint32_t MOTION_BLOCK{16};
+
+/**
+ * @return Sum of absolute differences of two blocks, or a value of at least
+ * limit as soon as the partial sum of complete rows reaches limit.
+ */
+uint32_t blockSad(const uint8_t *a, uint32_t strideA, const uint8_t *b, uint32_t strideB, uint32_t limit) {
+    uint32_t sad{0};
+    for (uint32_t row{0}; (row < MOTION_BLOCK) && (sad < limit); row++, a += strideA, b += strideB) {
+        for (uint32_t x{0}; x < MOTION_BLOCK; x++) {
+            sad += static_cast<uint32_t>(std::abs(a[x] - b[x]));
+        }
+    }
+    return sad;
+}
+
+/**
+ * This function finds for every complete block of current the displacement
+ * within +/-range pixels that minimizes the SAD to previous (exhaustive
+ * search; the zero vector wins ties, and candidates reaching outside of the
+ * plane are skipped).
+ */
+void estimateMotion(const uint8_t *current, uint32_t currentStride, const uint8_t *previous, uint32_t previousStride, uint32_t width, uint32_t height, int32_t range, MotionVector *vectors) {
+    for (uint32_t y{0}; y + MOTION_BLOCK <= height; y += MOTION_BLOCK) {
+        for (uint32_t x{0}; x + MOTION_BLOCK <= width; x += MOTION_BLOCK, vectors++) {
+            const uint8_t *block{current + y * currentStride + x};
+            uint32_t best{blockSad(block, currentStride, previous + y * previousStride + x, previousStride, 0xFFFFFFFFu)};
+            int32_t bestX{0};
+            int32_t bestY{0};
+            const int32_t MIN_Y{std::max(-range, -static_cast<int32_t>(y))};
+            const int32_t MAX_Y{std::min(range, static_cast<int32_t>(height - MOTION_BLOCK - y))};
+            const int32_t MIN_X{std::max(-range, -static_cast<int32_t>(x))};
+            const int32_t MAX_X{std::min(range, static_cast<int32_t>(width - MOTION_BLOCK - x))};
+            for (int32_t dy{MIN_Y}; (dy <= MAX_Y) && (0 < best); dy++) {
+                for (int32_t dx{MIN_X}; dx <= MAX_X; dx++) {
+                    const uint32_t SAD{blockSad(block, currentStride, previous + static_cast<int32_t>(y) * static_cast<int32_t>(previousStride) + dy * static_cast<int32_t>(previousStride) + static_cast<int32_t>(x) + dx, previousStride, best)};
+                    if (SAD < best) {
+                        best = SAD;
+                        bestX = dx;
+                        bestY = dy;
+                    }
+                }
+            }
+            vectors->dx = static_cast<int8_t>(bestX);
+            vectors->dy = static_cast<int8_t>(bestY);
+            vectors->sad = static_cast<uint16_t>(best);
+        }
+    }
+}
+
+/**
+ * This function reads the lookup tables for Y, U, and V (256 bytes each) from
+ * the given file into lut.
+ * @return true if the file contains exactly three tables.
+ */
+bool readLut(const std::string &filename, uint8_t *lut) {
+    std::ifstream file{filename, std::ios::binary};
+    std::vector<char> content{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (3 * 256 != content.size()) {
+        return false;
+    }
+    std::memcpy(lut, content.data(), content.size());
+    return true;
+}
+
+/**
+ * This function computes the lookup tables for Y, U, and V (256 bytes each)
+ * for the given gamma, contrast, and brightness adjustment of Y and saturation
+ * adjustment of U and V.
+ */
+void computeLut(float gamma, float contrast, float brightness, float saturation, uint8_t *lut) {
+    for (uint32_t i{0}; i < 256; i++) {
+        const float Y{std::pow(static_cast<float>(i) / 255.0f, 1.0f / gamma) * 255.0f};
+        const float C{(static_cast<float>(i) - 128.0f) * saturation + 128.0f};
+        lut[i] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, std::round((Y - 128.0f) * contrast + 128.0f + brightness))));
+        lut[256 + i] = lut[512 + i] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, std::round(C))));
+    }
+}
+
+/**
+ * Precomputed mapping from every pixel of a destination plane to a position in
+ * a source plane for remapPlane. Entries are stored tile by tile (tileSize x
+ * tileSize pixels, row-major within each tile) in the order they are used; each
+ * holds the offset of the top-left of the four neighboring source pixels and the
+ * fixed-point fractions (REMAP_FRACTION_BITS) towards the right and bottom ones.
+ * Destination pixels mapped outside the source plane have offset REMAP_BORDER.
+ */
+struct RemapEntry {
+    uint32_t offset;
+    uint16_t fractionX;
+    uint16_t fractionY;
+};
+struct RemapTable {
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t tileSize{0};
+    std::vector<RemapEntry> entries{};
+};
+constexpr uint32_t REMAP_BORDER{0xFFFFFFFFu};
+constexpr uint32_t REMAP_FRACTION_BITS{8};
+constexpr uint32_t REMAP_TILE_SIZE{32};
+
+/**
+ * This function builds the RemapTable for a destination plane with the given
+ * size from the given mapping, which sets the source position (in pixels of a
+ * source plane with the given size and stride) of a destination pixel.
+ */
+template <typename MAPPING>
+void buildRemapTable(RemapTable &table, uint32_t width, uint32_t height, uint32_t tileSize, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcStride, MAPPING mapping) {
+    constexpr float ONE{static_cast<float>(1u << REMAP_FRACTION_BITS)};
+    table.width = width;
+    table.height = height;
+    table.tileSize = tileSize;
+    table.entries.clear();
+    table.entries.reserve(width * height);
+    for (uint32_t tileY{0}; tileY < height; tileY += tileSize) {
+        for (uint32_t tileX{0}; tileX < width; tileX += tileSize) {
+            for (uint32_t y{tileY}; y < std::min(tileY + tileSize, height); y++) {
+                for (uint32_t x{tileX}; x < std::min(tileX + tileSize, width); x++) {
+                    float srcX{0};
+                    float srcY{0};
+                    mapping(static_cast<float>(x), static_cast<float>(y), srcX, srcY);
+                    RemapEntry entry{REMAP_BORDER, 0, 0};
+                    if ( (0.0f <= srcX) && (srcX <= static_cast<float>(srcWidth - 1)) && (0.0f <= srcY) && (srcY <= static_cast<float>(srcHeight - 1)) ) {
+                        const uint32_t FIXED_X{static_cast<uint32_t>(std::lround(srcX * ONE))};
+                        const uint32_t FIXED_Y{static_cast<uint32_t>(std::lround(srcY * ONE))};
+                        const uint32_t X0{std::min(FIXED_X >> REMAP_FRACTION_BITS, srcWidth - 2)};
+                        const uint32_t Y0{std::min(FIXED_Y >> REMAP_FRACTION_BITS, srcHeight - 2)};
+                        entry.offset = Y0 * srcStride + X0;
+                        entry.fractionX = static_cast<uint16_t>(FIXED_X - (X0 << REMAP_FRACTION_BITS));
+                        entry.fractionY = static_cast<uint16_t>(FIXED_Y - (Y0 << REMAP_FRACTION_BITS));
+                    }
+                    table.entries.push_back(entry);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * This function fills the destination plane by bilinear interpolation in the
+ * source plane at the positions given in table; positions outside the source
+ * plane are filled with border.
+ */
+void remapPlane(const uint8_t *src, uint32_t srcStride, const RemapTable &table, uint8_t *dst, uint32_t dstStride, uint8_t border) {
+    constexpr uint32_t ONE{1u << REMAP_FRACTION_BITS};
+    const RemapEntry *entry{table.entries.data()};
+    for (uint32_t tileY{0}; tileY < table.height; tileY += table.tileSize) {
+        for (uint32_t tileX{0}; tileX < table.width; tileX += table.tileSize) {
+            for (uint32_t y{tileY}; y < std::min(tileY + table.tileSize, table.height); y++) {
+                uint8_t *dstRow{dst + y * dstStride};
+                for (uint32_t x{tileX}; x < std::min(tileX + table.tileSize, table.width); x++, entry++) {
+                    if (REMAP_BORDER == entry->offset) {
+                        dstRow[x] = border;
+                        continue;
+                    }
+                    const uint8_t *p{src + entry->offset};
+                    const uint32_t TOP{p[0] * (ONE - entry->fractionX) + p[1] * entry->fractionX};
+                    const uint32_t BOTTOM{p[srcStride] * (ONE - entry->fractionX) + p[srcStride + 1] * entry->fractionX};
+                    dstRow[x] = static_cast<uint8_t>((TOP * (ONE - entry->fractionY) + BOTTOM * entry->fractionY + (ONE * ONE / 2)) >> (2 * REMAP_FRACTION_BITS));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * This function maps all values of the given region of a plane through lut.
+ */
+void applyLut(uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, const uint8_t *lut) {
+    for (uint32_t row{0}; row < height; row++) {
+        uint8_t *p{plane + row * stride};
+        for (uint32_t x{0}; x < width; x++) {
+            p[x] = lut[p[x]];
+        }
+    }
+}
+
+/**
+ * Gain map in fixed point (GAIN_FRACTION_BITS, i.e., 256 is a gain of 1.0) that
+ * is sampled on a grid with the given step in pixels of the plane it is applied
+ * to: grid point (i, j) belongs to pixel (i * step, j * step) and the grid has
+ * one point beyond the last row and column of the plane.
+ */
+struct GainMap {
+    uint32_t step{1};
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<uint16_t> gains{};
+};
+constexpr uint32_t GAIN_FRACTION_BITS{8};
+constexpr uint32_t GAIN_MAX_STEP{64};
+
+/**
+ * This function reads a binary PGM file with 16-bit values (P5 with a maximum
+ * value above 255, big-endian) into width, height, and values.
+ * @return true if the file could be read.
+ */
+bool readPgm16(const std::string &filename, uint32_t &width, uint32_t &height, std::vector<uint16_t> &values) {
+    std::ifstream file{filename, std::ios::binary};
+    std::string magic;
+    uint32_t fields[3]{0, 0, 0};
+    file >> magic;
+    for (uint32_t i{0}; (i < 3) && file; i++) {
+        file >> std::ws;
+        while ('#' == file.peek()) {
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            file >> std::ws;
+        }
+        file >> fields[i];
+    }
+    // A single whitespace separates the header from the values.
+    file.get();
+    if ( !file || ("P5" != magic) || (0 == fields[0]) || (0 == fields[1]) || (255 >= fields[2]) || (65535 < fields[2]) ) {
+        return false;
+    }
+    width = fields[0];
+    height = fields[1];
+    std::vector<uint8_t> content(width * height * 2);
+    file.read(reinterpret_cast<char*>(content.data()), static_cast<std::streamsize>(content.size()));
+    if (static_cast<std::streamsize>(content.size()) != file.gcount()) {
+        return false;
+    }
+    values.resize(width * height);
+    for (uint32_t i{0}; i < values.size(); i++) {
+        values[i] = static_cast<uint16_t>((content[2 * i] << 8) | content[2 * i + 1]);
+    }
+    return true;
+}
+
+/**
+ * This function multiplies all values of the given region of a plane with
+ * gainMap, which is upsampled bilinearly into rowGains (width values) row by
+ * row, and maps the results through lut (if given) in the same pass.
+ */
+void applyGainMap(uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, const GainMap &gainMap, uint16_t *rowGains, const uint8_t *lut) {
+    const uint32_t STEP{gainMap.step};
+    for (uint32_t row{0}; row < height; row++) {
+        const uint32_t J{row / STEP};
+        const uint32_t FRACTION_Y{row - J * STEP};
+        const uint16_t *top{gainMap.gains.data() + J * gainMap.width};
+        const uint16_t *bottom{top + gainMap.width};
+        for (uint32_t i{0}; i * STEP < width; i++) {
+            const uint32_t LEFT{top[i] * (STEP - FRACTION_Y) + bottom[i] * FRACTION_Y};
+            const uint32_t RIGHT{top[i + 1] * (STEP - FRACTION_Y) + bottom[i + 1] * FRACTION_Y};
+            for (uint32_t k{0}; (k < STEP) && (i * STEP + k < width); k++) {
+                rowGains[i * STEP + k] = static_cast<uint16_t>((LEFT * (STEP - k) + RIGHT * k + STEP * STEP / 2) / (STEP * STEP));
+            }
+        }
+
+        uint8_t *p{plane + row * stride};
+        constexpr uint32_t ROUNDING{1u << (GAIN_FRACTION_BITS - 1)};
+        if (nullptr != lut) {
+            for (uint32_t x{0}; x < width; x++) {
+                p[x] = lut[std::min((p[x] * rowGains[x] + ROUNDING) >> GAIN_FRACTION_BITS, 255u)];
+            }
+        }
+        else {
+            for (uint32_t x{0}; x < width; x++) {
+                p[x] = static_cast<uint8_t>(std::min((p[x] * rowGains[x] + ROUNDING) >> GAIN_FRACTION_BITS, 255u));
+            }
+        }
+    }
+}
+
+/**
+ * Layout of the privacy mask control area: Other processes lock the area and
+ * set the regions (in pixels of the output image) that are masked from the
+ * next frame on in addition to the ones given on the command line.
+ */
+struct MaskRegion {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+constexpr uint32_t MASK_MAX_REGIONS{64};
+struct MaskControl {
+    uint32_t count;
+    MaskRegion regions[MASK_MAX_REGIONS];
+};
+
+/**
+ * This function replaces all values of the given region of a plane with the
+ * mean value of their block; blocks are aligned to the plane so that they do
+ * not change when a region moves.
+ */
+void pixelateRegion(uint8_t *plane, uint32_t stride, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t block) {
+    for (uint32_t blockY{y - y % block}; blockY < y + height; blockY += block) {
+        const uint32_t Y0{std::max(blockY, y)};
+        const uint32_t Y1{std::min(blockY + block, y + height)};
+        for (uint32_t blockX{x - x % block}; blockX < x + width; blockX += block) {
+            const uint32_t X0{std::max(blockX, x)};
+            const uint32_t X1{std::min(blockX + block, x + width)};
+            uint32_t sum{0};
+            for (uint32_t row{Y0}; row < Y1; row++) {
+                const uint8_t *p{plane + row * stride};
+                for (uint32_t col{X0}; col < X1; col++) {
+                    sum += p[col];
+                }
+            }
+            const uint32_t COUNT{(X1 - X0) * (Y1 - Y0)};
+            const uint8_t MEAN{static_cast<uint8_t>((sum + COUNT / 2) / COUNT)};
+            for (uint32_t row{Y0}; row < Y1; row++) {
+                std::memset(plane + row * stride + X0, MEAN, X1 - X0);
+            }
+        }
+    }
+}
+
+/**
+ * 5x7 pixel font for the text overlay (bit 4 is the leftmost column); lower case
+ * letters are drawn as upper case ones and other characters as space.
+ */
+struct Glyph {
+    char character;
+    uint8_t rows[7];
+};
+constexpr Glyph FONT[]{
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {'#', {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'A', {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}},
+    {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+    {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+    {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+    {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+    {'_', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}},
+};
+constexpr uint32_t GLYPH_WIDTH{6};
+constexpr uint32_t GLYPH_HEIGHT{9};
+
+/**
+ * This function renders all characters of the font with the given integer
+ * scale into atlas as Y values (235 on 16) for drawText; every character is a
+ * cell of GLYPH_WIDTH x GLYPH_HEIGHT scaled pixels including the spacing.
+ */
+void buildGlyphAtlas(uint32_t scale, std::vector<uint8_t> &atlas) {
+    const uint32_t CELL_WIDTH{GLYPH_WIDTH * scale};
+    const uint32_t CELL_HEIGHT{GLYPH_HEIGHT * scale};
+    atlas.assign(128 * CELL_WIDTH * CELL_HEIGHT, 16);
+    for (const auto &glyph : FONT) {
+        uint8_t *cell{atlas.data() + static_cast<uint32_t>(glyph.character) * CELL_WIDTH * CELL_HEIGHT};
+        for (uint32_t y{0}; y < CELL_HEIGHT; y++) {
+            const uint32_t ROW{y / scale};
+            for (uint32_t x{0}; x < CELL_WIDTH; x++) {
+                const uint32_t COLUMN{x / scale};
+                // The glyph starts one row below the top of its cell and is followed by a column of spacing.
+                if ( (0 < ROW) && (ROW <= 7) && (COLUMN < 5) && (0 != (glyph.rows[ROW - 1] & (0x10 >> COLUMN))) ) {
+                    cell[y * CELL_WIDTH + x] = 235;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * This function copies the cells of all characters of text from the glyph
+ * atlas into the given plane at (x, y), clipped to the plane; bytes outside
+ * of ASCII (e.g. of UTF-8 sequences) are drawn as spaces.
+ * @return Width of the drawn text in pixels.
+ */
+uint32_t drawText(const char *text, const std::vector<uint8_t> &atlas, uint32_t scale, uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, uint32_t x, uint32_t y) {
+    const uint32_t CELL_WIDTH{GLYPH_WIDTH * scale};
+    const uint32_t CELL_HEIGHT{GLYPH_HEIGHT * scale};
+    uint32_t column{x};
+    for (const char *c{text}; ('\0' != *c) && (column < width); c++, column += CELL_WIDTH) {
+        const unsigned char BYTE{static_cast<unsigned char>(*c)};
+        const uint32_t CHARACTER{(128 > BYTE) ? static_cast<uint32_t>(std::toupper(BYTE)) : static_cast<uint32_t>(' ')};
+        const uint8_t *cell{atlas.data() + CHARACTER * CELL_WIDTH * CELL_HEIGHT};
+        const uint32_t COLUMNS{std::min(CELL_WIDTH, width - column)};
+        for (uint32_t row{0}; (row < CELL_HEIGHT) && (y + row < height); row++) {
+            std::memcpy(plane + (y + row) * stride + column, cell + row * CELL_WIDTH, COLUMNS);
+        }
+    }
+    return std::min(column, width) - x;
+}
+
+/**
+ * Layout of the shared memory area created for the foreground output
+ * (--out.foreground): ForegroundHeader with the size of the mask (the Y plane
+ * without the padding in fit mode reduced by scale) and the bounding boxes of
+ * the largest blobs in pixels of the output image, followed by the mask with
+ * 255 for foreground and 0 for background.
+ */
+struct ForegroundBox {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixels;
+};
+constexpr uint32_t FOREGROUND_MAX_BOXES{32};
+struct ForegroundHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t scale;
+    uint32_t boxCount;
+    ForegroundBox boxes[FOREGROUND_MAX_BOXES];
+};
+
+/**
+ * This function updates the running average background (8.8 fixed point) with
+ * the given rate (in 1/256) and sets mask to 255 where frame differs from the
+ * background by more than threshold and to 0 elsewhere.
+ */
+void updateBackground(const uint8_t *frame, uint16_t *background, uint8_t *mask, uint32_t count, int32_t rate, int32_t threshold) {
+    for (uint32_t i{0}; i < count; i++) {
+        const int32_t DIFFERENCE{(frame[i] << 8) - background[i]};
+        mask[i] = (std::abs(DIFFERENCE) > (threshold << 8)) ? 255 : 0;
+        background[i] = static_cast<uint16_t>(background[i] + DIFFERENCE * rate / 256);
+    }
+}
+
+/**
+ * @return Root of the given label in the union-find forest parents.
+ */
+uint32_t findRoot(uint32_t *parents, uint32_t label) {
+    while (parents[label] != label) {
+        parents[label] = parents[parents[label]];
+        label = parents[label];
+    }
+    return label;
+}
+
+/**
+ * This function labels the 4-connected blobs of non-zero values of mask in
+ * two passes with union-find; labels, parents, and blobs must hold
+ * width * height + 1 entries so that no memory is allocated.
+ * @return Number of blobs with at least minimumPixels pixels, whose bounding
+ * boxes (in pixels of mask) are stored at the beginning of blobs.
+ */
+uint32_t findBlobs(const uint8_t *mask, uint32_t width, uint32_t height, uint32_t minimumPixels, uint32_t *labels, uint32_t *parents, ForegroundBox *blobs) {
+    uint32_t count{0};
+    for (uint32_t y{0}; y < height; y++) {
+        for (uint32_t x{0}; x < width; x++) {
+            const uint32_t I{y * width + x};
+            const uint32_t LEFT{(0 < x) ? labels[I - 1] : 0};
+            const uint32_t UP{(0 < y) ? labels[I - width] : 0};
+            if (0 == mask[I]) {
+                labels[I] = 0;
+            }
+            else if ( (0 == LEFT) && (0 == UP) ) {
+                count++;
+                parents[count] = count;
+                labels[I] = count;
+            }
+            else if ( (0 != LEFT) && (0 != UP) ) {
+                const uint32_t A{findRoot(parents, LEFT)};
+                const uint32_t B{findRoot(parents, UP)};
+                labels[I] = std::min(A, B);
+                parents[std::max(A, B)] = std::min(A, B);
+            }
+            else {
+                labels[I] = LEFT + UP;
+            }
+        }
+    }
+
+    // The bounding boxes are collected with the minimum in x, y and the maximum in width, height first.
+    for (uint32_t label{1}; label <= count; label++) {
+        blobs[label] = ForegroundBox{width, height, 0, 0, 0};
+    }
+    for (uint32_t y{0}; y < height; y++) {
+        for (uint32_t x{0}; x < width; x++) {
+            if (0 != labels[y * width + x]) {
+                ForegroundBox &blob{blobs[findRoot(parents, labels[y * width + x])]};
+                blob.x = std::min(blob.x, x);
+                blob.y = std::min(blob.y, y);
+                blob.width = std::max(blob.width, x);
+                blob.height = std::max(blob.height, y);
+                blob.pixels++;
+            }
+        }
+    }
+    uint32_t blobCount{0};
+    for (uint32_t label{1}; label <= count; label++) {
+        const ForegroundBox BLOB{blobs[label]};
+        if ( (parents[label] == label) && (minimumPixels <= BLOB.pixels) ) {
+            blobs[blobCount++] = ForegroundBox{BLOB.x, BLOB.y, BLOB.width - BLOB.x + 1, BLOB.height - BLOB.y + 1, BLOB.pixels};
+        }
+    }
+    return blobCount;
+}
+
+/**
+ * This function compares two sample grids from sampleLuma in blocks of
+ * GATE_BLOCK x GATE_BLOCK samples, so that also a small change in an otherwise
+ * static image is detected.
+ * @return Largest mean absolute difference of a block.
+ */
+constexpr uint32_t GATE_BLOCK{8};
+float largestBlockDifference(const uint8_t *samples, const uint8_t *reference, uint32_t columns, uint32_t rows) {
+    uint32_t largest{0};
+    for (uint32_t blockY{0}; blockY < rows; blockY += GATE_BLOCK) {
+        for (uint32_t blockX{0}; blockX < columns; blockX += GATE_BLOCK) {
+            uint32_t sad{0};
+            for (uint32_t row{blockY}; row < std::min(blockY + GATE_BLOCK, rows); row++) {
+                for (uint32_t col{blockX}; col < std::min(blockX + GATE_BLOCK, columns); col++) {
+                    sad += static_cast<uint32_t>(std::abs(samples[row * columns + col] - reference[row * columns + col]));
+                }
+            }
+            // Normalize the blocks at the right and bottom border to full blocks.
+            const uint32_t COUNT{(std::min(blockX + GATE_BLOCK, columns) - blockX) * (std::min(blockY + GATE_BLOCK, rows) - blockY)};
+            largest = std::max(largest, sad * GATE_BLOCK * GATE_BLOCK / COUNT);
+        }
+    }
+    return static_cast<float>(largest) / static_cast<float>(GATE_BLOCK * GATE_BLOCK);
+}
+
+/**
+ * @return IEEE 754 half precision representation of value.
+ */
+uint16_t toFloat16(float value) {
+    uint32_t bits{0};
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t SIGN{static_cast<uint16_t>((bits >> 16) & 0x8000u)};
+    const int32_t EXPONENT{static_cast<int32_t>((bits >> 23) & 0xffu) - 127 + 15};
+    uint32_t mantissa{bits & 0x7fffffu};
+    if (31 <= EXPONENT) {
+        return SIGN | 0x7c00u;
+    }
+    if (0 >= EXPONENT) {
+        if (-10 > EXPONENT) {
+            return SIGN;
+        }
+        mantissa |= 0x800000u;
+        const uint32_t SHIFT{static_cast<uint32_t>(14 - EXPONENT)};
+        return static_cast<uint16_t>(SIGN | ((mantissa + (1u << (SHIFT - 1))) >> SHIFT));
+    }
+    // Rounding may carry into the exponent, which is the correct result.
+    return static_cast<uint16_t>((SIGN | (static_cast<uint32_t>(EXPONENT) << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1u));
+}
+
+/**
+ * This function normalizes one row of RGB pixels into the tensor using one
+ * 256-entry lookup table per channel that contains the normalized values.
+ */
+template <typename T>
+void rgbToTensor(const uint8_t *rgb, uint32_t width, const T *lut, T *dst, uint32_t channelStride, uint32_t pixelStride) {
+    T *dstR{dst};
+    T *dstG{dst + channelStride};
+    T *dstB{dst + 2 * channelStride};
+    for (uint32_t x{0}; x < width; x++) {
+        dstR[x * pixelStride] = lut[rgb[3 * x]];
+        dstG[x * pixelStride] = lut[256 + rgb[3 * x + 1]];
+        dstB[x * pixelStride] = lut[512 + rgb[3 * x + 2]];
+    }
+}
+
+/**
+ * This function converts a region of an I420 image with the given stride into
+ * the corresponding region of a normalized RGB tensor, whose top-left value is
+ * at dst. Two rows at a time are converted by libyuv into rowBuffer, which
+ * stays in the cache while being normalized into the tensor.
+ */
+template <typename T>
+void i420ToTensor(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t stride, uint32_t width, uint32_t height, std::vector<uint8_t> &rowBuffer, const std::vector<T> &lut, TensorLayout layout, T *dst, uint32_t tensorWidth, uint32_t tensorHeight) {
+    for (uint32_t row{0}; row < height; row += 2) {
+        const uint32_t ROWS{std::min(2u, height - row)};
+        libyuv::I420ToRAW(y + row * stride, stride,
+                          u + (row/2) * (stride/2), stride/2,
+                          v + (row/2) * (stride/2), stride/2,
+                          rowBuffer.data(), width * 3, width, ROWS);
+        for (uint32_t r{0}; r < ROWS; r++) {
+            if (TENSOR_CHW == layout) {
+                rgbToTensor(rowBuffer.data() + r * width * 3, width, lut.data(), dst + (row + r) * tensorWidth, tensorWidth * tensorHeight, 1);
+            }
+            else {
+                rgbToTensor(rowBuffer.data() + r * width * 3, width, lut.data(), dst + (row + r) * tensorWidth * 3, 1, 3);
+            }
+        }
+    }
+}
+
+/**
+ * Input formats that can be selected with --in.format; most are converted by
+ * libyuv::ConvertToI420 in the same pass as cropping and rotating. Formats with
+ * 16 bits per sample are not supported by libyuv::ConvertToI420 and are hence
+ * cropped and converted by convert16ToI420 using their downconversionScale
+ * (8 bit value = (16 bit value * downconversionScale) >> 16); Bayer mosaics,
+ * whose names describe the colors of the top-left 2x2 block, are cropped and
+ * demosaiced by bayerToI420. The luma field describes how --luma can extract
+ * the Y plane without processing chroma; formats without a Y plane are fully
+ * converted instead.
+ */
+enum InputConversion { INPUT_LIBYUV, INPUT_16BIT, INPUT_BAYER };
+enum InputLuma { LUMA_PLANE, LUMA_PLANE_16BIT, LUMA_YUYV, LUMA_UYVY, LUMA_CONVERTED };
+struct InputFormat {
+    const char *name;
+    uint32_t fourcc;
+    uint32_t bitsPerPixel;
+    InputConversion conversion;
+    int downconversionScale;
+    bool semiPlanar;
+    InputLuma luma;
+};
+const InputFormat INPUT_FORMATS[] = {
+    {"i420", FOURCC('I', '4', '2', '0'), 12, INPUT_LIBYUV, 0, false, LUMA_PLANE},
+    {"yv12", FOURCC('Y', 'V', '1', '2'), 12, INPUT_LIBYUV, 0, false, LUMA_PLANE},
+    {"nv12", FOURCC('N', 'V', '1', '2'), 12, INPUT_LIBYUV, 0, false, LUMA_PLANE},
+    {"nv21", FOURCC('N', 'V', '2', '1'), 12, INPUT_LIBYUV, 0, false, LUMA_PLANE},
+    {"yuyv", FOURCC('Y', 'U', 'Y', '2'), 16, INPUT_LIBYUV, 0, false, LUMA_YUYV},
+    {"uyvy", FOURCC('U', 'Y', 'V', 'Y'), 16, INPUT_LIBYUV, 0, false, LUMA_UYVY},
+    {"i400", FOURCC('I', '4', '0', '0'), 8, INPUT_LIBYUV, 0, false, LUMA_PLANE},
+    {"rgb565", FOURCC('R', 'G', 'B', 'P'), 16, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"rgb24", FOURCC('2', '4', 'B', 'G'), 24, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"raw", FOURCC('r', 'a', 'w', ' '), 24, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"argb", FOURCC('A', 'R', 'G', 'B'), 32, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"abgr", FOURCC('A', 'B', 'G', 'R'), 32, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"bgra", FOURCC('B', 'G', 'R', 'A'), 32, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"rgba", FOURCC('R', 'G', 'B', 'A'), 32, INPUT_LIBYUV, 0, false, LUMA_CONVERTED},
+    {"p010", FOURCC('P', '0', '1', '0'), 24, INPUT_16BIT, 256, true, LUMA_PLANE_16BIT},
+    {"p016", FOURCC('P', '0', '1', '6'), 24, INPUT_16BIT, 256, true, LUMA_PLANE_16BIT},
+    {"i010", FOURCC('I', '0', '1', '0'), 24, INPUT_16BIT, 16384, false, LUMA_PLANE_16BIT},
+    {"i016", FOURCC('I', '0', '1', '6'), 24, INPUT_16BIT, 256, false, LUMA_PLANE_16BIT},
+    {"rggb", FOURCC('R', 'G', 'G', 'B'), 8, INPUT_BAYER, 0, false, LUMA_CONVERTED},
+    {"bggr", FOURCC('B', 'G', 'G', 'R'), 8, INPUT_BAYER, 0, false, LUMA_CONVERTED},
+    {"grbg", FOURCC('G', 'R', 'B', 'G'), 8, INPUT_BAYER, 0, false, LUMA_CONVERTED},
+    {"gbrg", FOURCC('G', 'B', 'R', 'G'), 8, INPUT_BAYER, 0, false, LUMA_CONVERTED},
+};
+
+/**
+ * This function samples the luma of every step-th pixel of every step-th row
+ * of an input image in the given format into samples, which holds
+ * (width / step) x (height / step) bytes. 16 bit samples are reduced to their
+ * 8 most significant bits like in the downconversion; RGB formats are sampled
+ * on green, which follows the brightness closely enough to detect changes, and
+ * Bayer mosaics on the mean of the 2x2 cell (R, G, G, B) around the position
+ * so that changes in any color are seen regardless of the pattern.
+ */
+void sampleLuma(const uint8_t *src, const InputFormat &format, uint32_t width, uint32_t height, uint32_t step, uint8_t *samples) {
+    const uint32_t COLUMNS{width / step};
+    const bool RGB565{(LUMA_CONVERTED == format.luma) && (16 == format.bitsPerPixel)};
+    if ( (LUMA_PLANE_16BIT == format.luma) || RGB565 ) {
+        const uint32_t SCALE{static_cast<uint32_t>(format.downconversionScale)};
+        for (uint32_t row{0}; row < height / step; row++) {
+            const uint16_t *p{reinterpret_cast<const uint16_t*>(src) + row * step * width};
+            for (uint32_t col{0}; col < COLUMNS; col++) {
+                const uint32_t VALUE{p[col * step]};
+                samples[row * COLUMNS + col] = static_cast<uint8_t>(RGB565 ? ((VALUE >> 3) & 0xfc) : std::min((VALUE * SCALE) >> 16, 255u));
+            }
+        }
+        return;
+    }
+
+    if (INPUT_BAYER == format.conversion) {
+        for (uint32_t row{0}; row < height / step; row++) {
+            const uint8_t *p{src + std::min((row * step) & ~1u, height - 2) * width};
+            for (uint32_t col{0}; col < COLUMNS; col++) {
+                const uint32_t X{std::min((col * step) & ~1u, width - 2)};
+                samples[row * COLUMNS + col] = static_cast<uint8_t>((p[X] + p[X + 1] + p[width + X] + p[width + X + 1] + 2) / 4);
+            }
+        }
+        return;
+    }
+
+    // Packed formats are sampled on the byte of Y or G in each pixel; libyuv's BGRA and RGBA have alpha first.
+    uint32_t bytesPerPixel{1};
+    uint32_t offset{0};
+    if ( (LUMA_YUYV == format.luma) || (LUMA_UYVY == format.luma) ) {
+        bytesPerPixel = 2;
+        offset = (LUMA_UYVY == format.luma) ? 1 : 0;
+    }
+    else if (LUMA_CONVERTED == format.luma) {
+        bytesPerPixel = format.bitsPerPixel / 8;
+        offset = ((FOURCC('B', 'G', 'R', 'A') == format.fourcc) || (FOURCC('R', 'G', 'B', 'A') == format.fourcc)) ? 2 : 1;
+    }
+    for (uint32_t row{0}; row < height / step; row++) {
+        const uint8_t *p{src + row * step * width * bytesPerPixel + offset};
+        for (uint32_t col{0}; col < COLUMNS; col++) {
+            samples[row * COLUMNS + col] = p[col * step * bytesPerPixel];
+        }
+    }
+}
+
+/**
+ * This function demosaics one row of the crop area of an 8 bit Bayer image by
+ * bilinear interpolation into ARGB; rows and columns outside of the image are
+ * mirrored so that the color pattern is preserved.
+ */
+void bayerRowToARGB(const uint8_t *src, uint32_t width, uint32_t height, const char *pattern, uint32_t cropX, uint32_t y, uint32_t cropWidth, uint8_t *dst) {
+    const uint8_t *above{src + ((0 < y) ? y - 1 : y + 1) * width};
+    const uint8_t *row{src + y * width};
+    const uint8_t *below{src + ((y + 1 < height) ? y + 1 : y - 1) * width};
+    const char *colors{pattern + (y & 1) * 2};
+    for (uint32_t i{0}; i < cropWidth; i++) {
+        const uint32_t X{cropX + i};
+        const uint32_t LEFT{(0 < X) ? X - 1 : X + 1};
+        const uint32_t RIGHT{(X + 1 < width) ? X + 1 : X - 1};
+        const char COLOR{colors[X & 1]};
+        uint32_t r, g, b;
+        if ('g' == COLOR) {
+            const uint32_t HORIZONTAL{(row[LEFT] + row[RIGHT] + 1u) >> 1};
+            const uint32_t VERTICAL{(above[X] + below[X] + 1u) >> 1};
+            const bool RED_IN_ROW{'r' == colors[(X + 1) & 1]};
+            g = row[X];
+            r = RED_IN_ROW ? HORIZONTAL : VERTICAL;
+            b = RED_IN_ROW ? VERTICAL : HORIZONTAL;
+        }
+        else {
+            const uint32_t CROSS{(above[X] + below[X] + row[LEFT] + row[RIGHT] + 2u) >> 2};
+            const uint32_t DIAGONAL{(above[LEFT] + above[RIGHT] + below[LEFT] + below[RIGHT] + 2u) >> 2};
+            g = CROSS;
+            r = ('r' == COLOR) ? row[X] : DIAGONAL;
+            b = ('r' == COLOR) ? DIAGONAL : row[X];
+        }
+        dst[4 * i + 0] = static_cast<uint8_t>(b);
+        dst[4 * i + 1] = static_cast<uint8_t>(g);
+        dst[4 * i + 2] = static_cast<uint8_t>(r);
+        dst[4 * i + 3] = 255;
+    }
+}
+
+/**
+ * This function bins the 2x2 blocks of two rows of the crop area of an 8 bit
+ * Bayer image into one ARGB row of half the width without any interpolation.
+ */
+void bayerBinRowToARGB(const uint8_t *src, uint32_t width, const char *pattern, uint32_t cropX, uint32_t y, uint32_t halfWidth, uint8_t *dst) {
+    // Find the offsets of the red, both green, and the blue sample within a 2x2 block.
+    uint32_t offsetR{0}, offsetG1{0}, offsetG2{0}, offsetB{0};
+    bool firstGreen{true};
+    for (uint32_t i{0}; i < 4; i++) {
+        const uint32_t OFFSET{(i >> 1) * width + (i & 1)};
+        const char COLOR{pattern[((y + (i >> 1)) & 1) * 2 + ((cropX + (i & 1)) & 1)]};
+        if ('r' == COLOR) {
+            offsetR = OFFSET;
+        }
+        else if ('b' == COLOR) {
+            offsetB = OFFSET;
+        }
+        else {
+            (firstGreen ? offsetG1 : offsetG2) = OFFSET;
+            firstGreen = false;
+        }
+    }
+    const uint8_t *block{src + y * width + cropX};
+    for (uint32_t i{0}; i < halfWidth; i++) {
+        dst[4 * i + 0] = block[2 * i + offsetB];
+        dst[4 * i + 1] = static_cast<uint8_t>((block[2 * i + offsetG1] + block[2 * i + offsetG2] + 1u) >> 1);
+        dst[4 * i + 2] = block[2 * i + offsetR];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+/**
+ * This function demosaics the crop area of an 8 bit Bayer image into the given
+ * I420 planes, either in full resolution or, when binning, in half resolution.
+ * Two rows at a time are demosaiced into rowBuffer, which stays in the cache
+ * while being converted by libyuv.
+ */
+void bayerToI420(const uint8_t *src, uint32_t width, uint32_t height, const char *pattern, bool binning,
+                 uint32_t cropX, uint32_t cropY, uint32_t cropWidth, uint32_t cropHeight, std::vector<uint8_t> &rowBuffer,
+                 uint8_t *dstY, uint32_t strideY, uint8_t *dstU, uint32_t strideU, uint8_t *dstV, uint32_t strideV) {
+    const uint32_t WIDTH{binning ? cropWidth/2 : cropWidth};
+    const uint32_t HEIGHT{binning ? cropHeight/2 : cropHeight};
+    for (uint32_t row{0}; row < HEIGHT; row += 2) {
+        const uint32_t ROWS{std::min(2u, HEIGHT - row)};
+        for (uint32_t r{0}; r < ROWS; r++) {
+            if (binning) {
+                bayerBinRowToARGB(src, width, pattern, cropX, cropY + 2 * (row + r), WIDTH, rowBuffer.data() + r * WIDTH * 4);
+            }
+            else {
+                bayerRowToARGB(src, width, height, pattern, cropX, cropY + row + r, WIDTH, rowBuffer.data() + r * WIDTH * 4);
+            }
+        }
+        libyuv::ARGBToI420(rowBuffer.data(), WIDTH * 4,
+                           dstY + row * strideY, strideY,
+                           dstU + (row/2) * strideU, strideU,
+                           dstV + (row/2) * strideV, strideV,
+                           WIDTH, ROWS);
+    }
+}
+
+/**
+ * This function converts a region of an I420 image with the given stride into
+ * the corresponding region of a packed RGB image with the given width.
+ */
+template <int (*CONVERT)(const uint8_t*, int, const uint8_t*, int, const uint8_t*, int, uint8_t*, int, int, int), uint32_t BYTES_PER_PIXEL>
+void i420ToPacked(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t stride, uint8_t *dst, uint32_t dstWidth, uint32_t /*dstHeight*/, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height) {
+    CONVERT(y, stride, u, stride/2, v, stride/2, dst + (y0 * dstWidth + x0) * BYTES_PER_PIXEL, dstWidth * BYTES_PER_PIXEL, width, height);
+}
+
+/**
+ * This function converts a region of an I420 image with the given stride into
+ * the corresponding region of a semi-planar image (Y plane followed by an
+ * interleaved chroma plane) with the given width and height.
+ */
+template <int (*CONVERT)(const uint8_t*, int, const uint8_t*, int, const uint8_t*, int, uint8_t*, int, uint8_t*, int, int, int)>
+void i420ToSemiPlanar(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t stride, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height) {
+    uint8_t *dstUV{dst + dstWidth * dstHeight};
+    CONVERT(y, stride, u, stride/2, v, stride/2, dst + y0 * dstWidth + x0, dstWidth, dstUV + (y0/2) * dstWidth + x0, dstWidth, width, height);
+}
+
+/**
+ * This function converts a region of an I420 image with the given stride into
+ * the corresponding region of an I422 image (Y plane followed by U and V planes
+ * with half the width) with the given width and height. Each chroma row is
+ * interpolated from the nearest two I420 chroma rows of the whole image (3:1)
+ * so that converting band by band results in the same image.
+ */
+void i420ToI422(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t stride, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height) {
+    const uint32_t CHROMA_STRIDE{stride/2};
+    const uint32_t CHROMA_WIDTH{dstWidth/2};
+    const uint32_t CHROMA_ROWS{dstHeight/2};
+    libyuv::CopyPlane(y, stride, dst + y0 * dstWidth + x0, dstWidth, width, height);
+    for (uint32_t plane{0}; plane < 2; plane++) {
+        const uint8_t *origin{((0 == plane) ? u : v) - (y0/2) * CHROMA_STRIDE};
+        uint8_t *dstChroma{dst + dstWidth * dstHeight + plane * CHROMA_WIDTH * dstHeight + x0/2};
+        for (uint32_t row{y0}; row < y0 + height; row++) {
+            const uint32_t NEAREST{row/2};
+            const uint32_t NEIGHBOR{(row & 1) ? std::min(NEAREST + 1, CHROMA_ROWS - 1) : ((0 < NEAREST) ? NEAREST - 1 : 0)};
+            libyuv::InterpolatePlane(origin + NEAREST * CHROMA_STRIDE, 0, origin + NEIGHBOR * CHROMA_STRIDE, 0, dstChroma + row * CHROMA_WIDTH, 0, width/2, 1, 64);
+        }
+    }
+}
+
+/**
+ * This function converts a region of an I420 image with the given stride into
+ * the corresponding region of an I444 image (Y, U, and V planes with the same
+ * size) with the given width and height. Chroma is interpolated bilinearly
+ * (3:1 in both directions) from the whole I420 image like in i420ToI422.
+ */
+void i420ToI444(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t stride, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height) {
+    const uint32_t CHROMA_STRIDE{stride/2};
+    const uint32_t CHROMA_COLUMNS{dstWidth/2};
+    const uint32_t CHROMA_ROWS{dstHeight/2};
+    libyuv::CopyPlane(y, stride, dst + y0 * dstWidth + x0, dstWidth, width, height);
+    for (uint32_t plane{0}; plane < 2; plane++) {
+        const uint8_t *origin{((0 == plane) ? u : v) - (y0/2) * CHROMA_STRIDE - x0/2};
+        uint8_t *dstChroma{dst + (1 + plane) * dstWidth * dstHeight};
+        for (uint32_t row{y0}; row < y0 + height; row++) {
+            const uint32_t NEAREST{row/2};
+            const uint32_t NEIGHBOR{(row & 1) ? std::min(NEAREST + 1, CHROMA_ROWS - 1) : ((0 < NEAREST) ? NEAREST - 1 : 0)};
+            const uint8_t *nearest{origin + NEAREST * CHROMA_STRIDE};
+            const uint8_t *neighbor{origin + NEIGHBOR * CHROMA_STRIDE};
+            uint8_t *dstRow{dstChroma + row * dstWidth};
+            // Vertically interpolated samples are scaled by 4 and horizontally interpolated ones by 16.
+            for (uint32_t column{x0/2}; column < (x0 + width)/2; column++) {
+                const uint32_t LEFT{(0 < column) ? column - 1 : 0};
+                const uint32_t RIGHT{std::min(column + 1, CHROMA_COLUMNS - 1)};
+                const uint32_t CENTER_VALUE{3u * nearest[column] + neighbor[column]};
+                dstRow[column * 2] = static_cast<uint8_t>((3u * CENTER_VALUE + 3u * nearest[LEFT] + neighbor[LEFT] + 8u) >> 4);
+                dstRow[column * 2 + 1] = static_cast<uint8_t>((3u * CENTER_VALUE + 3u * nearest[RIGHT] + neighbor[RIGHT] + 8u) >> 4);
+            }
+        }
+    }
+}
+
+/**
+ * Output formats that can be requested with --out.<name> in addition to the
+ * I420 image; they are converted from the I420 image and their shared memory
+ * areas have exactly width * height * bitsPerPixel / 8 bytes.
+ */
+struct OutputFormat {
+    const char *name;
+    const char *description;
+    uint32_t bitsPerPixel;
+    void (*convert)(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t stride, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height);
+};
+const OutputFormat OUTPUT_FORMATS[] = {
+    {"argb", "ARGB (bytes B, G, R, A)", 32, i420ToPacked<libyuv::I420ToARGB, 4>},
+    {"abgr", "ABGR (bytes R, G, B, A)", 32, i420ToPacked<libyuv::I420ToABGR, 4>},
+    {"bgra", "BGRA (bytes A, R, G, B)", 32, i420ToPacked<libyuv::I420ToBGRA, 4>},
+    {"rgba", "RGBA (bytes A, B, G, R)", 32, i420ToPacked<libyuv::I420ToRGBA, 4>},
+    {"rgb24", "RGB24 (bytes B, G, R)", 24, i420ToPacked<libyuv::I420ToRGB24, 3>},
+    {"raw", "RAW (bytes R, G, B)", 24, i420ToPacked<libyuv::I420ToRAW, 3>},
+    {"rgb565", "RGB565", 16, i420ToPacked<libyuv::I420ToRGB565, 2>},
+    {"nv12", "NV12", 12, i420ToSemiPlanar<libyuv::I420ToNV12>},
+    {"nv21", "NV21", 12, i420ToSemiPlanar<libyuv::I420ToNV21>},
+    {"i422", "I422", 16, i420ToI422},
+    {"i444", "I444", 24, i420ToI444},
+};
+
+/**
+ * Shared memory area for an image in one of the OUTPUT_FORMATS.
+ */
+struct Output {
+    const OutputFormat *format{nullptr};
+    std::unique_ptr<cluon::SharedMemory> sharedMemory{nullptr};
+};
+
 int32_t main(int32_t argc, char **argv) {
     int32_t retCode{1};
     auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
@@ -40,17 +1324,27 @@ int32_t main(int32_t argc, char **argv) {
         commandlineArguments.count("scale.width") +
         commandlineArguments.count("scale.height")
     };
-    if ( (0 == commandlineArguments.count("in")) ||
+    if ( (0 != commandlineArguments.count("sync")) && (0 != commandlineArguments.count("out")) ) {
+        retCode = synchronize(commandlineArguments);
+    }
+    else if ( (0 == commandlineArguments.count("in")) ||
          (0 == commandlineArguments.count("in.width")) ||
          (0 == commandlineArguments.count("in.height")) ||
          (0 == commandlineArguments.count("out")) ||
          ( (0 != cropCounter) && (4 != cropCounter) ) ||
          ( (0 != scaleCounter) && (2 != scaleCounter) ) ) {
         std::cerr << argv[0] << " waits on a shared memory containing an image in I420 format to apply image operations resulting into two corresponding images in I420 and ARGB format in two other shared memory areas." << std::endl;
-        std::cerr << "Usage:   " << argv[0] << " --in=<name of shared memory for the I420 image> --in.width=<width> --in.height=<height> --out=<name of shared memory to be created for the I420 image> [--flip] [--crop.x=<x> --crop.y=<y> --crop.width=<width> --crop.height=<height>] [--scale.width=<width> --scale.height=<height>] [--verbose]" << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --in=<name of shared memory for the I420 image> --in.width=<width> --in.height=<height> --out=<name of shared memory to be created for the I420 image> [--flip | --rotate=<degrees>] [--mirror.horizontal] [--mirror.vertical] [--crop.x=<x> --crop.y=<y> --crop.width=<width> --crop.height=<height>] [--scale.width=<width> --scale.height=<height>] [--luma] [--verbose]" << std::endl;
+        std::cerr << "         " << argv[0] << " --sync=<comma-separated names of shared memory areas> --out=<name of shared memory to be created for the synchronized frames> [--sync.tolerance=<ms>] [--sync.depth=<frames>]" << std::endl;
         std::cerr << "         --in:         name of the shared memory area containing the I420 image" << std::endl;
         std::cerr << "         --out:        name of the shared memory area to be created for the I420 image" << std::endl;
         std::cerr << "         --out.argb:   name of the shared memory area to be created for the ARGB image (default: value from --out + '.argb')" << std::endl;
+        for (const auto &format : OUTPUT_FORMATS) {
+            if (std::string{"argb"} != format.name) {
+                std::cerr << "         --out." << format.name << ": name of the shared memory area to be created for an image in " << format.description << " format" << std::endl;
+            }
+        }
+        std::cerr << "         --in.format:    format of the input image: i420 (default), yv12, nv12, nv21, yuyv, uyvy, i400, rgb565, rgb24, raw, argb, abgr, bgra, rgba, p010, p016, i010, i016, rggb, bggr, grbg, or gbrg" << std::endl;
         std::cerr << "         --in.width:     width of the input image" << std::endl;
         std::cerr << "         --in.height:    height of the input image" << std::endl;
         std::cerr << "         --crop.x:       crop this area from the input image (x for top left)" << std::endl;
@@ -59,155 +1353,1708 @@ int32_t main(int32_t argc, char **argv) {
         std::cerr << "         --crop.height:  crop this area from the input image (height)" << std::endl;
         std::cerr << "         --scale.width:  scale optionally cropped area to this final width" << std::endl;
         std::cerr << "         --scale.height: scale optionally cropped area to this final height" << std::endl;
+        std::cerr << "         --scale.mode:   stretch (default), fit (letterbox with padding), or fill (center crop) to preserve the aspect ratio" << std::endl;
+        std::cerr << "         --scale.padding: comma-separated RGB color of the padding in fit mode (default: 0,0,0)" << std::endl;
         std::cerr << "         --flip:         rotate image by 180 degrees" << std::endl;
+        std::cerr << "         --rotate:       rotate image clockwise by 0 (default), 90, 180, or 270 degrees; output dimensions are swapped for 90 and 270" << std::endl;
+        std::cerr << "         --mirror.horizontal: mirror image left to right before rotating" << std::endl;
+        std::cerr << "         --mirror.vertical:   mirror image top to bottom before rotating" << std::endl;
+        std::cerr << "         --luma:         provide only the Y plane of the image in --out without any chroma processing, ARGB image, or further outputs" << std::endl;
         std::cerr << "         --verbose:      display output image" << std::endl;
+        std::cerr << "         --out.tensor:        name of the shared memory area to be created for a normalized RGB tensor" << std::endl;
+        std::cerr << "         --tensor.layout:     chw (default) or hwc" << std::endl;
+        std::cerr << "         --tensor.type:       float32 (default), float16, or int8" << std::endl;
+        std::cerr << "         --tensor.mean:       comma-separated per-channel mean in [0,1] (default: 0,0,0)" << std::endl;
+        std::cerr << "         --tensor.std:        comma-separated per-channel standard deviation (default: 1,1,1)" << std::endl;
+        std::cerr << "         --tensor.int8.scale: quantization step for int8 tensors (default: 1/127)" << std::endl;
+        std::cerr << "         --tensor.batch:      number of i420toolbox instances sharing one batched tensor in --out.tensor (default: 1)" << std::endl;
+        std::cerr << "         --tensor.slot:       slot in the batched tensor filled by this instance (default: 0)" << std::endl;
+        std::cerr << "         --tensor.deadline:   publish an incomplete batch when it is older than this in ms (default: 50)" << std::endl;
+        std::cerr << "         --out.pyramid:    name of the shared memory area to be created for an image pyramid" << std::endl;
+        std::cerr << "         --pyramid.levels: number of levels including the output image (default: 4)" << std::endl;
+        std::cerr << "         --pyramid.format: y (default) or i420" << std::endl;
+        std::cerr << "         --out.integral:   name of the shared memory area to be created for the integral image of the Y plane" << std::endl;
+        std::cerr << "         --integral.squared: provide also the integral image of the squared Y values" << std::endl;
+        std::cerr << "         --out.stats:      name of the shared memory area to be created for statistics of the Y plane" << std::endl;
+        std::cerr << "         --stats.columns:  number of tile columns for per-tile means (default: 0)" << std::endl;
+        std::cerr << "         --stats.rows:     number of tile rows for per-tile means (default: 0)" << std::endl;
+        std::cerr << "         --stats.clip.low: Y values up to this count as underexposed (default: 16)" << std::endl;
+        std::cerr << "         --stats.clip.high: Y values from this count as overexposed (default: 235)" << std::endl;
+        std::cerr << "         --gate:           skip converting and publishing frames whose largest mean absolute difference of sampled blocks from the last published frame is not above this value" << std::endl;
+        std::cerr << "         --gate.keepalive: publish a frame at least every this many milliseconds (default: 1000)" << std::endl;
+        std::cerr << "         --gate.step:      distance in pixels and rows of the sampled luma values in the input image (default: 8)" << std::endl;
+        std::cerr << "         --hud:            name of a shared memory area with an ARGB layer of the output size to be alpha-blended into the ARGB output" << std::endl;
+        std::cerr << "         --hud.i420:       blend the HUD layer into the I420 output instead, so that all output formats contain it" << std::endl;
+        std::cerr << "         --overlay:        text to be drawn into the output image; %t is replaced by the sample time stamp (UTC), %n by the frame number" << std::endl;
+        std::cerr << "         --overlay.x:      left of the overlay text in the output image without the padding in fit mode (default: 8)" << std::endl;
+        std::cerr << "         --overlay.y:      top of the overlay text in the output image without the padding in fit mode (default: 8)" << std::endl;
+        std::cerr << "         --overlay.scale:  integer scale of the 5x7 pixel font (default: 2)" << std::endl;
+        std::cerr << "         --mask:           comma-separated regions x,y,width,height in the output image to be masked before publishing" << std::endl;
+        std::cerr << "         --mask.control:   name of the shared memory area to be created for setting further masked regions at runtime" << std::endl;
+        std::cerr << "         --mask.mode:      fill (default, black) or pixelate" << std::endl;
+        std::cerr << "         --mask.block:     block size for pixelate (default: 16)" << std::endl;
+        std::cerr << "         --denoise:        strength of the temporal filter in [0, 1), i.e., weight of the history for static values" << std::endl;
+        std::cerr << "         --denoise.threshold: difference from the history from which on a value is regarded as moving (default: 16)" << std::endl;
+        std::cerr << "         --denoise.bypass: fraction of moving Y values from which on a frame is not filtered (default: 0.25)" << std::endl;
+        std::cerr << "         --flatfield:      binary PGM file with 16-bit gains (256 = 1.0) for the Y values of the input image; may have a lower resolution" << std::endl;
+        std::cerr << "         --out.motion:     name of the shared memory area to be created for motion vectors of 16x16 blocks between consecutive frames" << std::endl;
+        std::cerr << "         --motion.range:   search range in pixels for the motion vectors (default: 4)" << std::endl;
+        std::cerr << "         --out.foreground: name of the shared memory area to be created for a foreground mask with bounding boxes from a background model" << std::endl;
+        std::cerr << "         --foreground.scale: reduction of the Y plane for the background model (default: 4)" << std::endl;
+        std::cerr << "         --foreground.threshold: difference from the background from which on a value is foreground (default: 25)" << std::endl;
+        std::cerr << "         --foreground.rate: learning rate of the running average background in (0, 1] (default: 0.02)" << std::endl;
+        std::cerr << "         --foreground.min: minimum number of mask pixels of a blob to get a bounding box (default: 4)" << std::endl;
+        std::cerr << "         --out.warp:       name of the shared memory area to be created for a perspective warp (e.g. bird's-eye view) of the input image" << std::endl;
+        std::cerr << "         --warp.matrix:    comma-separated 3x3 homography (row-major) mapping input pixels to warp pixels" << std::endl;
+        std::cerr << "         --warp.width:     width of the warp image (default: output width)" << std::endl;
+        std::cerr << "         --warp.height:    height of the warp image (default: output height)" << std::endl;
+        std::cerr << "         --lut:            file with lookup tables for Y, U, and V (256 bytes each) applied to the image; reloaded when changed" << std::endl;
+        std::cerr << "         --lut.gamma:      gamma correction of Y (default: 1)" << std::endl;
+        std::cerr << "         --lut.contrast:   contrast factor for Y around 128 (default: 1)" << std::endl;
+        std::cerr << "         --lut.brightness: offset added to Y (default: 0)" << std::endl;
+        std::cerr << "         --lut.saturation: factor for U and V around 128 (default: 1)" << std::endl;
+        std::cerr << "         --undistort.camera:     comma-separated camera intrinsics fx,fy,cx,cy in pixels of the input image to undistort it" << std::endl;
+        std::cerr << "         --undistort.distortion: comma-separated distortion coefficients k1,k2,p1,p2[,k3] (default: 0,0,0,0,0)" << std::endl;
+        std::cerr << "         --sync:           group frames from these shared memory areas with matching sample time stamps into --out" << std::endl;
+        std::cerr << "         --sync.tolerance: maximum difference between sample time stamps in a group in ms (default: 10)" << std::endl;
+        std::cerr << "         --sync.depth:     number of latest frames buffered per input (default: 4)" << std::endl;
         std::cerr << "Example: " << argv[0] << " --in=video0.i420 --in.width=640 --in.height=480 --flip --out=imgout.i420 --verbose" << std::endl;
     }
     else {
         const std::string IN{commandlineArguments["in"]};
+        const std::string IN_FORMAT{(commandlineArguments.count("in.format") != 0) ? commandlineArguments["in.format"] : "i420"};
         const std::string OUT{commandlineArguments["out"]};
         const std::string OUT_ARGB{(commandlineArguments.count("out.argb") != 0) ? commandlineArguments["out.argb"] : (OUT + ".argb")};
         const std::string OUT_SCALE{(OUT + ".scale")};
         const uint32_t IN_WIDTH{static_cast<uint32_t>(std::stoi(commandlineArguments["in.width"]))};
         const uint32_t IN_HEIGHT{static_cast<uint32_t>(std::stoi(commandlineArguments["in.height"]))};
-        const uint32_t CROP_X{(commandlineArguments.count("crop.x") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.x"])) : 0u};
-        const uint32_t CROP_Y{(commandlineArguments.count("crop.y") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.y"])) : 0u};
-        const uint32_t CROP_WIDTH{(commandlineArguments.count("crop.width") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.width"])) : IN_WIDTH};
-        const uint32_t CROP_HEIGHT{(commandlineArguments.count("crop.height") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.height"])) : IN_HEIGHT};
-        const uint32_t OUT_WIDTH{CROP_WIDTH};
-        const uint32_t OUT_HEIGHT{CROP_HEIGHT};
+        const InputFormat *inputFormat{nullptr};
+        for (const auto &format : INPUT_FORMATS) {
+            inputFormat = (IN_FORMAT == format.name) ? &format : inputFormat;
+        }
+        if (nullptr == inputFormat) {
+            std::cerr << "[i420toolbox]: Unknown input format '" << IN_FORMAT << "'." << std::endl;
+            return retCode;
+        }
+        const uint32_t IN_FOURCC{inputFormat->fourcc};
+        const uint32_t IN_SIZE{IN_WIDTH * IN_HEIGHT * inputFormat->bitsPerPixel / 8};
+        const uint32_t REQUESTED_CROP_X{(commandlineArguments.count("crop.x") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.x"])) : 0u};
+        const uint32_t REQUESTED_CROP_Y{(commandlineArguments.count("crop.y") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.y"])) : 0u};
+        const uint32_t REQUESTED_CROP_WIDTH{(commandlineArguments.count("crop.width") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.width"])) : IN_WIDTH};
+        const uint32_t REQUESTED_CROP_HEIGHT{(commandlineArguments.count("crop.height") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["crop.height"])) : IN_HEIGHT};
         const uint32_t SCALE_WIDTH{(commandlineArguments.count("scale.width") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["scale.width"])) : 0u};
         const uint32_t SCALE_HEIGHT{(commandlineArguments.count("scale.height") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["scale.height"])) : 0u};
-        const uint32_t ROTATE{(commandlineArguments.count("flip") != 0) ? 180u : 0u};
+        const std::string SCALE_MODE{(commandlineArguments.count("scale.mode") != 0) ? commandlineArguments["scale.mode"] : "stretch"};
+        const std::vector<float> SCALE_PADDING{toFloats((commandlineArguments.count("scale.padding") != 0) ? commandlineArguments["scale.padding"] : "0,0,0")};
+
+        // Mirroring is applied before rotating; as libyuv only inverts vertically while converting, a horizontal mirror is a vertical one rotated by further 180 degrees.
+        const uint32_t REQUESTED_ROTATE{(commandlineArguments.count("rotate") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["rotate"])) :
+                                        ((commandlineArguments.count("flip") != 0) ? 180u : 0u)};
+        const bool MIRROR_HORIZONTAL{commandlineArguments.count("mirror.horizontal") != 0};
+        const bool MIRROR_VERTICAL{commandlineArguments.count("mirror.vertical") != 0};
+        const bool INVERT{MIRROR_HORIZONTAL != MIRROR_VERTICAL};
+        const uint32_t ROTATE{(REQUESTED_ROTATE + (MIRROR_HORIZONTAL ? 180u : 0u)) % 360u};
+        const bool TRANSPOSE{(90u == ROTATE) || (270u == ROTATE)};
+        if ( (0u != REQUESTED_ROTATE) && (90u != REQUESTED_ROTATE) && (180u != REQUESTED_ROTATE) && (270u != REQUESTED_ROTATE) ) {
+            std::cerr << "[i420toolbox]: --rotate must be 0, 90, 180, or 270." << std::endl;
+            return retCode;
+        }
+
+        // In fill mode, the crop area shrinks around its center to the aspect ratio of the scaled image; both are compared in output orientation.
+        const uint32_t ORIENTED_CROP_WIDTH{TRANSPOSE ? REQUESTED_CROP_HEIGHT : REQUESTED_CROP_WIDTH};
+        const uint32_t ORIENTED_CROP_HEIGHT{TRANSPOSE ? REQUESTED_CROP_WIDTH : REQUESTED_CROP_HEIGHT};
+        const bool FILL{("fill" == SCALE_MODE) && (0 < SCALE_WIDTH * SCALE_HEIGHT)};
+        const bool IS_WIDER{static_cast<uint64_t>(ORIENTED_CROP_WIDTH) * SCALE_HEIGHT > static_cast<uint64_t>(ORIENTED_CROP_HEIGHT) * SCALE_WIDTH};
+        const uint32_t OUT_WIDTH{(FILL && IS_WIDER) ? static_cast<uint32_t>(static_cast<uint64_t>(ORIENTED_CROP_HEIGHT) * SCALE_WIDTH / SCALE_HEIGHT) & ~1u : ORIENTED_CROP_WIDTH};
+        const uint32_t OUT_HEIGHT{(FILL && !IS_WIDER) ? static_cast<uint32_t>(static_cast<uint64_t>(ORIENTED_CROP_WIDTH) * SCALE_HEIGHT / SCALE_WIDTH) & ~1u : ORIENTED_CROP_HEIGHT};
+        const uint32_t CROP_WIDTH{TRANSPOSE ? OUT_HEIGHT : OUT_WIDTH};
+        const uint32_t CROP_HEIGHT{TRANSPOSE ? OUT_WIDTH : OUT_HEIGHT};
+        const uint32_t CROP_X{REQUESTED_CROP_X + (((REQUESTED_CROP_WIDTH - CROP_WIDTH) / 2) & ~1u)};
+        const uint32_t CROP_Y{REQUESTED_CROP_Y + (((REQUESTED_CROP_HEIGHT - CROP_HEIGHT) / 2) & ~1u)};
         const bool VERBOSE{commandlineArguments.count("verbose") != 0};
+        const bool LUMA{commandlineArguments.count("luma") != 0};
+
+        const std::string OUT_PYRAMID{(commandlineArguments.count("out.pyramid") != 0) ? commandlineArguments["out.pyramid"] : ""};
+        const uint32_t PYRAMID_LEVELS{(commandlineArguments.count("pyramid.levels") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["pyramid.levels"])) : 4u};
+        const std::string PYRAMID_FORMAT{(commandlineArguments.count("pyramid.format") != 0) ? commandlineArguments["pyramid.format"] : "y"};
+
+        const std::string OUT_INTEGRAL{(commandlineArguments.count("out.integral") != 0) ? commandlineArguments["out.integral"] : ""};
+        const bool INTEGRAL_SQUARED{commandlineArguments.count("integral.squared") != 0};
+
+        const std::string OUT_STATS{(commandlineArguments.count("out.stats") != 0) ? commandlineArguments["out.stats"] : ""};
+        const uint32_t STATS_COLUMNS{(commandlineArguments.count("stats.columns") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["stats.columns"])) : 0u};
+        const uint32_t STATS_ROWS{(commandlineArguments.count("stats.rows") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["stats.rows"])) : 0u};
+        const uint32_t STATS_CLIP_LOW{(commandlineArguments.count("stats.clip.low") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["stats.clip.low"])) : 16u};
+        const uint32_t STATS_CLIP_HIGH{(commandlineArguments.count("stats.clip.high") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["stats.clip.high"])) : 235u};
+
+        const std::string LUT_FILE{(commandlineArguments.count("lut") != 0) ? commandlineArguments["lut"] : ""};
+        const float LUT_GAMMA{(commandlineArguments.count("lut.gamma") != 0) ? std::stof(commandlineArguments["lut.gamma"]) : 1.0f};
+        const float LUT_CONTRAST{(commandlineArguments.count("lut.contrast") != 0) ? std::stof(commandlineArguments["lut.contrast"]) : 1.0f};
+        const float LUT_BRIGHTNESS{(commandlineArguments.count("lut.brightness") != 0) ? std::stof(commandlineArguments["lut.brightness"]) : 0.0f};
+        const float LUT_SATURATION{(commandlineArguments.count("lut.saturation") != 0) ? std::stof(commandlineArguments["lut.saturation"]) : 1.0f};
+        const bool LUT{!LUT_FILE.empty() || (0 != commandlineArguments.count("lut.gamma")) || (0 != commandlineArguments.count("lut.contrast")) ||
+                       (0 != commandlineArguments.count("lut.brightness")) || (0 != commandlineArguments.count("lut.saturation"))};
+
+        const std::vector<float> UNDISTORT_CAMERA{toFloats((commandlineArguments.count("undistort.camera") != 0) ? commandlineArguments["undistort.camera"] : "")};
+        const std::vector<float> UNDISTORT_DISTORTION{toFloats((commandlineArguments.count("undistort.distortion") != 0) ? commandlineArguments["undistort.distortion"] : "0,0,0,0,0")};
+        const bool UNDISTORT{!UNDISTORT_CAMERA.empty()};
+
+        const std::string OUT_WARP{(commandlineArguments.count("out.warp") != 0) ? commandlineArguments["out.warp"] : ""};
+        const std::vector<float> WARP_MATRIX{toFloats((commandlineArguments.count("warp.matrix") != 0) ? commandlineArguments["warp.matrix"] : "")};
+
+        const std::string FLATFIELD_FILE{(commandlineArguments.count("flatfield") != 0) ? commandlineArguments["flatfield"] : ""};
+        const bool FLATFIELD{!FLATFIELD_FILE.empty()};
+
+        const bool DENOISE{0 != commandlineArguments.count("denoise")};
+        const float DENOISE_STRENGTH{DENOISE ? std::stof(commandlineArguments["denoise"]) : 0.0f};
+        const uint32_t DENOISE_THRESHOLD{(commandlineArguments.count("denoise.threshold") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["denoise.threshold"])) : 16u};
+        const float DENOISE_BYPASS{(commandlineArguments.count("denoise.bypass") != 0) ? std::stof(commandlineArguments["denoise.bypass"]) : 0.25f};
+
+        const std::vector<float> MASK_REGIONS{toFloats((commandlineArguments.count("mask") != 0) ? commandlineArguments["mask"] : "")};
+        const std::string MASK_CONTROL{(commandlineArguments.count("mask.control") != 0) ? commandlineArguments["mask.control"] : ""};
+        const bool MASK_PIXELATE{(commandlineArguments.count("mask.mode") != 0) && ("pixelate" == commandlineArguments["mask.mode"])};
+        const uint32_t MASK_BLOCK{(commandlineArguments.count("mask.block") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["mask.block"])) : 16u};
+        const bool MASKS{!MASK_REGIONS.empty() || !MASK_CONTROL.empty()};
+
+        const std::string OVERLAY{(commandlineArguments.count("overlay") != 0) ? commandlineArguments["overlay"] : ""};
+        const uint32_t OVERLAY_X{(commandlineArguments.count("overlay.x") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["overlay.x"])) : 8u};
+        const uint32_t OVERLAY_Y{(commandlineArguments.count("overlay.y") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["overlay.y"])) : 8u};
+        const uint32_t OVERLAY_SCALE{(commandlineArguments.count("overlay.scale") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["overlay.scale"])) : 2u};
+
+        const std::string HUD{(commandlineArguments.count("hud") != 0) ? commandlineArguments["hud"] : ""};
+        const bool HUD_I420{0 != commandlineArguments.count("hud.i420")};
+
+        const bool GATE{0 != commandlineArguments.count("gate")};
+        const float GATE_THRESHOLD{GATE ? std::stof(commandlineArguments["gate"]) : 0.0f};
+        const int64_t GATE_KEEPALIVE{(commandlineArguments.count("gate.keepalive") != 0) ? std::stoll(commandlineArguments["gate.keepalive"]) * 1000 : 1000000};
+        const uint32_t GATE_STEP{(commandlineArguments.count("gate.step") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["gate.step"])) : 8u};
+
+        const std::string OUT_MOTION{(commandlineArguments.count("out.motion") != 0) ? commandlineArguments["out.motion"] : ""};
+        const uint32_t MOTION_RANGE{(commandlineArguments.count("motion.range") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["motion.range"])) : 4u};
+
+        const std::string OUT_FOREGROUND{(commandlineArguments.count("out.foreground") != 0) ? commandlineArguments["out.foreground"] : ""};
+        const uint32_t FOREGROUND_SCALE{(commandlineArguments.count("foreground.scale") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["foreground.scale"])) : 4u};
+        const uint32_t FOREGROUND_THRESHOLD{(commandlineArguments.count("foreground.threshold") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["foreground.threshold"])) : 25u};
+        const float FOREGROUND_RATE{(commandlineArguments.count("foreground.rate") != 0) ? std::stof(commandlineArguments["foreground.rate"]) : 0.02f};
+        const uint32_t FOREGROUND_MIN{(commandlineArguments.count("foreground.min") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["foreground.min"])) : 4u};
+
+        const std::string OUT_TENSOR{(commandlineArguments.count("out.tensor") != 0) ? commandlineArguments["out.tensor"] : ""};
+        const TensorLayout TENSOR_LAYOUT{((commandlineArguments.count("tensor.layout") != 0) && ("hwc" == commandlineArguments["tensor.layout"])) ? TENSOR_HWC : TENSOR_CHW};
+        const std::string TENSOR_TYPE{(commandlineArguments.count("tensor.type") != 0) ? commandlineArguments["tensor.type"] : "float32"};
+        const std::vector<float> TENSOR_MEAN{toFloats((commandlineArguments.count("tensor.mean") != 0) ? commandlineArguments["tensor.mean"] : "0,0,0")};
+        const std::vector<float> TENSOR_STDDEV{toFloats((commandlineArguments.count("tensor.std") != 0) ? commandlineArguments["tensor.std"] : "1,1,1")};
+        const float TENSOR_SCALE{(commandlineArguments.count("tensor.int8.scale") != 0) ? std::stof(commandlineArguments["tensor.int8.scale"]) : 1.0f/127.0f};
+        const uint32_t TENSOR_BATCH{(commandlineArguments.count("tensor.batch") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["tensor.batch"])) : 1u};
+        const uint32_t TENSOR_SLOT{(commandlineArguments.count("tensor.slot") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["tensor.slot"])) : 0u};
+        const uint32_t TENSOR_BANKS{(1 < TENSOR_BATCH) ? 2u : 1u};
+        const int64_t TENSOR_DEADLINE{(commandlineArguments.count("tensor.deadline") != 0) ? static_cast<int64_t>(std::stoi(commandlineArguments["tensor.deadline"])) * 1000 : 50 * 1000};
+
+        // Bayer images are binned to half the resolution when they are anyway scaled down by at least a factor of two.
+        const bool BAYER_BINNING{(INPUT_BAYER == inputFormat->conversion) && (0 < SCALE_WIDTH * SCALE_HEIGHT) &&
+                                 (SCALE_WIDTH * 2 <= OUT_WIDTH) && (SCALE_HEIGHT * 2 <= OUT_HEIGHT)};
+        const uint32_t CONVERTED_WIDTH{BAYER_BINNING ? (CROP_WIDTH/2) & ~1u : CROP_WIDTH};
+        const uint32_t CONVERTED_HEIGHT{BAYER_BINNING ? (CROP_HEIGHT/2) & ~1u : CROP_HEIGHT};
+
+        const uint32_t TEMP_WIDTH{(0 < SCALE_WIDTH) ? (TRANSPOSE ? CONVERTED_HEIGHT : CONVERTED_WIDTH) : 0};
+        const uint32_t TEMP_HEIGHT{(0 < SCALE_HEIGHT) ? (TRANSPOSE ? CONVERTED_WIDTH : CONVERTED_HEIGHT) : 0};
+        const uint32_t FINAL_WIDTH{(0 < SCALE_WIDTH) ? SCALE_WIDTH : OUT_WIDTH};
+        const uint32_t FINAL_HEIGHT{(0 < SCALE_HEIGHT) ? SCALE_HEIGHT : OUT_HEIGHT};
+        const uint32_t WARP_WIDTH{(commandlineArguments.count("warp.width") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["warp.width"])) : FINAL_WIDTH};
+        const uint32_t WARP_HEIGHT{(commandlineArguments.count("warp.height") != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["warp.height"])) : FINAL_HEIGHT};
+
+        // In fit mode, the image is scaled into the centered inner area that preserves the aspect ratio; the remaining area is padding.
+        const bool FIT{("fit" == SCALE_MODE) && (0 < SCALE_WIDTH * SCALE_HEIGHT)};
+        const uint32_t INNER_WIDTH{(FIT && !IS_WIDER) ? static_cast<uint32_t>(static_cast<uint64_t>(OUT_WIDTH) * SCALE_HEIGHT / OUT_HEIGHT) & ~1u : FINAL_WIDTH};
+        const uint32_t INNER_HEIGHT{(FIT && IS_WIDER) ? static_cast<uint32_t>(static_cast<uint64_t>(OUT_HEIGHT) * SCALE_WIDTH / OUT_WIDTH) & ~1u : FINAL_HEIGHT};
+        const uint32_t INNER_X{((FINAL_WIDTH - INNER_WIDTH) / 2) & ~1u};
+        const uint32_t INNER_Y{((FINAL_HEIGHT - INNER_HEIGHT) / 2) & ~1u};
+
+        if ( (("stretch" != SCALE_MODE) && ("fit" != SCALE_MODE) && ("fill" != SCALE_MODE)) || (3 != SCALE_PADDING.size()) ) {
+            std::cerr << "[i420toolbox]: --scale.mode must be stretch, fit, or fill and --scale.padding needs three values." << std::endl;
+            return retCode;
+        }
+        bool isFormatRequested{!OUT_TENSOR.empty()};
+        for (const auto &format : OUTPUT_FORMATS) {
+            isFormatRequested |= (0 != commandlineArguments.count(std::string{"out."} + format.name));
+        }
+        if (LUMA && isFormatRequested) {
+            std::cerr << "[i420toolbox]: --luma provides only the Y plane and cannot be combined with --out.<format> or --out.tensor." << std::endl;
+            return retCode;
+        }
+
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryIN;
+        std::vector<char> inputImageBuffer;
+        std::vector<char> tempImageBuffer;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_I420;
+        std::vector<Output> outputs;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_TENSOR;
+        std::vector<uint8_t> tensorRowBuffer;
+        std::vector<float> tensorLutFloat32;
+        std::vector<uint16_t> tensorLutFloat16;
+        std::vector<int8_t> tensorLutInt8;
+        TensorHeader tensorHeader{};
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_PYRAMID;
+        PyramidHeader pyramidHeader{};
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_INTEGRAL;
+        IntegralHeader integralHeader{};
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_STATS;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_MOTION;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_FOREGROUND;
+        const uint32_t FOREGROUND_WIDTH{(0 < FOREGROUND_SCALE) ? INNER_WIDTH / FOREGROUND_SCALE : 0};
+        const uint32_t FOREGROUND_HEIGHT{(0 < FOREGROUND_SCALE) ? INNER_HEIGHT / FOREGROUND_SCALE : 0};
+        std::vector<uint8_t> foregroundFrame;
+        std::vector<uint16_t> foregroundBackground;
+        std::vector<uint32_t> foregroundLabels;
+        std::vector<uint32_t> foregroundParents;
+        std::vector<ForegroundBox> foregroundBlobs;
+        bool foregroundValid{false};
+        std::vector<uint8_t> motionPrevious;
+        bool motionValid{false};
+        std::vector<uint64_t> statsTileSums;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_WARP;
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryMASK_CONTROL;
+        uint8_t lut[3 * 256];
+        struct timespec lutModificationTime{0, 0};
+
+        sharedMemoryIN.reset(new cluon::SharedMemory{IN});
+        if (sharedMemoryIN && sharedMemoryIN->valid()) {
+            std::clog << "[i420toolbox]: Attached to '" << sharedMemoryIN->name() << "' (" << sharedMemoryIN->size() << " bytes)." << std::endl;
+            if (IN_SIZE > sharedMemoryIN->size()) {
+                std::cerr << "[i420toolbox]: Shared memory '" << IN << "' is too small for an image in " << IN_FORMAT << " format (" << IN_SIZE << " bytes)." << std::endl;
+                return retCode;
+            }
+            inputImageBuffer.resize(sharedMemoryIN->size());
+        }
+        else {
+            std::cerr << "[i420toolbox]: Failed to attach to shared memory '" << IN << "'." << std::endl;
+            return retCode;
+        }
+
+        if ( 0 < (TEMP_WIDTH * TEMP_HEIGHT) ) {
+            tempImageBuffer.reserve(TEMP_WIDTH * TEMP_HEIGHT * 3/2);
+        } 
+
+        // In luma mode, the output consists only of the Y plane.
+        sharedMemoryOUT_I420.reset(new cluon::SharedMemory{OUT, FINAL_WIDTH * FINAL_HEIGHT * (LUMA ? 2 : 3)/2});
+        if (sharedMemoryOUT_I420 && sharedMemoryOUT_I420->valid()) {
+            std::clog << "[i420toolbox]: Created shared memory " << OUT << " (" << sharedMemoryOUT_I420->size() << " bytes) for " << (LUMA ? "a Y" : "an I420") << " image (width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+        }
+        else {
+            std::cerr << "[i420toolbox]: Failed to create shared memory for output image (I420)." << std::endl;
+            return retCode;
+        }
+        uint8_t *i420Y{reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data())};
+        uint8_t *i420U{i420Y + FINAL_WIDTH * FINAL_HEIGHT};
+        uint8_t *i420V{i420U + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2)};
+        uint8_t *innerY{i420Y + INNER_Y * FINAL_WIDTH + INNER_X};
+        uint8_t *innerU{i420U + (INNER_Y/2) * (FINAL_WIDTH/2) + INNER_X/2};
+        uint8_t *innerV{i420V + (INNER_Y/2) * (FINAL_WIDTH/2) + INNER_X/2};
+
+        // The ARGB image is always provided except in luma mode; all other formats only on request.
+        for (const auto &format : OUTPUT_FORMATS) {
+            const std::string KEY{std::string{"out."} + format.name};
+            if ( LUMA || ((std::string{"argb"} != format.name) && (0 == commandlineArguments.count(KEY))) ) {
+                continue;
+            }
+            const std::string NAME{(std::string{"argb"} == format.name) ? OUT_ARGB : commandlineArguments[KEY]};
+            Output output;
+            output.format = &format;
+            output.sharedMemory.reset(new cluon::SharedMemory{NAME, FINAL_WIDTH * FINAL_HEIGHT * format.bitsPerPixel / 8});
+            if (output.sharedMemory && output.sharedMemory->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << NAME << " (" << output.sharedMemory->size() << " bytes) for an image in " << format.description << " format (width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output image (" << format.description << ")." << std::endl;
+                return retCode;
+            }
+            outputs.push_back(std::move(output));
+        }
+        cluon::SharedMemory *sharedMemoryOUT_ARGB{outputs.empty() ? nullptr : outputs.front().sharedMemory.get()};
+
+        // The scene-change gate compares a sparse grid of luma samples of the raw input with the one of the last published frame.
+        const uint32_t GATE_COLUMNS{GATE ? IN_WIDTH / GATE_STEP : 0};
+        const uint32_t GATE_ROWS{GATE ? IN_HEIGHT / GATE_STEP : 0};
+        std::vector<uint8_t> gateSamples(GATE_COLUMNS * GATE_ROWS);
+        std::vector<uint8_t> gateReference(GATE_COLUMNS * GATE_ROWS);
+        int64_t gatePublished{0};
+        uint64_t gateSkipped{0};
+        uint64_t gateSkippedInRow{0};
+        if (GATE && ((0 == GATE_STEP) || (0 == GATE_COLUMNS) || (0 == GATE_ROWS) || (0.0f > GATE_THRESHOLD))) {
+            std::cerr << "[i420toolbox]: --gate needs a non-negative threshold and --gate.step must be smaller than the input image." << std::endl;
+            return retCode;
+        }
+
+        // The HUD layer is compared tile by tile with a cached copy every frame; only changed tiles are prepared again
+        // for blending (premultiplied ARGB or I420 with an alpha plane) and fully transparent tiles are skipped.
+        constexpr uint32_t HUD_TILE_WIDTH{64};
+        constexpr uint32_t HUD_TILE_HEIGHT{16};
+        const uint32_t HUD_COLUMNS{(INNER_WIDTH + HUD_TILE_WIDTH - 1) / HUD_TILE_WIDTH};
+        const uint32_t HUD_ROWS{(INNER_HEIGHT + HUD_TILE_HEIGHT - 1) / HUD_TILE_HEIGHT};
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryHUD;
+        std::vector<uint8_t> hudCache;
+        std::vector<uint8_t> hudPrepared;
+        std::vector<uint8_t> hudTileDirty;
+        std::vector<uint8_t> hudTileVisible;
+        if (!HUD.empty()) {
+            if (LUMA) {
+                std::cerr << "[i420toolbox]: --hud cannot be used with --luma." << std::endl;
+                return retCode;
+            }
+            sharedMemoryHUD.reset(new cluon::SharedMemory{HUD});
+            if (sharedMemoryHUD && sharedMemoryHUD->valid() && (FINAL_WIDTH * FINAL_HEIGHT * 4 <= static_cast<uint32_t>(sharedMemoryHUD->size()))) {
+                std::clog << "[i420toolbox]: Attached to HUD layer '" << sharedMemoryHUD->name() << "' (" << sharedMemoryHUD->size() << " bytes)." << std::endl;
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to attach to a HUD layer '" << HUD << "' in ARGB with the size of the output image." << std::endl;
+                return retCode;
+            }
+            hudCache.resize(FINAL_WIDTH * FINAL_HEIGHT * 4);
+            // Premultiplied ARGB, or I420 followed by the alpha plane.
+            hudPrepared.resize(HUD_I420 ? FINAL_WIDTH * FINAL_HEIGHT * 5/2 : FINAL_WIDTH * FINAL_HEIGHT * 4);
+            hudTileDirty.assign(HUD_COLUMNS * HUD_ROWS, 1);
+            hudTileVisible.assign(HUD_COLUMNS * HUD_ROWS, 0);
+        }
+
+        if (!OUT_PYRAMID.empty()) {
+            if ( (("y" != PYRAMID_FORMAT) && ("i420" != PYRAMID_FORMAT)) || (LUMA && ("i420" == PYRAMID_FORMAT)) ) {
+                std::cerr << "[i420toolbox]: --pyramid.format must be y or i420 (y in luma mode)." << std::endl;
+                return retCode;
+            }
+            pyramidHeader.format = ("i420" == PYRAMID_FORMAT) ? PYRAMID_I420 : PYRAMID_Y;
+            pyramidHeader.levels = PYRAMID_LEVELS;
+            uint32_t offset{(sizeof(PyramidHeader) + 63u) & ~63u};
+            for (uint32_t l{0}; l < std::min(PYRAMID_LEVELS, PYRAMID_MAX_LEVELS); l++) {
+                PyramidLevel &level{pyramidHeader.level[l]};
+                // I420 levels need even dimensions for their chroma planes.
+                const uint32_t MASK{(PYRAMID_I420 == pyramidHeader.format) ? ~1u : ~0u};
+                level.width = (0 == l) ? FINAL_WIDTH : (pyramidHeader.level[l - 1].width / 2) & MASK;
+                level.height = (0 == l) ? FINAL_HEIGHT : (pyramidHeader.level[l - 1].height / 2) & MASK;
+                level.size = level.width * level.height * ((PYRAMID_I420 == pyramidHeader.format) ? 3 : 2) / 2;
+                level.offset = offset;
+                offset = (offset + level.size + 63u) & ~63u;
+            }
+            const PyramidLevel &SMALLEST{pyramidHeader.level[std::max(1u, std::min(PYRAMID_LEVELS, PYRAMID_MAX_LEVELS)) - 1]};
+            if ( (0 == PYRAMID_LEVELS) || (PYRAMID_MAX_LEVELS < PYRAMID_LEVELS) || (2 > SMALLEST.width) || (2 > SMALLEST.height) ) {
+                std::cerr << "[i420toolbox]: --pyramid.levels must be between 1 and " << PYRAMID_MAX_LEVELS << " and the smallest level must be at least 2x2 pixels." << std::endl;
+                return retCode;
+            }
+
+            sharedMemoryOUT_PYRAMID.reset(new cluon::SharedMemory{OUT_PYRAMID, offset});
+            if (sharedMemoryOUT_PYRAMID && sharedMemoryOUT_PYRAMID->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_PYRAMID << " (" << sharedMemoryOUT_PYRAMID->size() << " bytes) for a pyramid with " << PYRAMID_LEVELS << " levels in " << ((PYRAMID_I420 == pyramidHeader.format) ? "I420" : "Y") << " format (width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+                sharedMemoryOUT_PYRAMID->lock();
+                std::memcpy(sharedMemoryOUT_PYRAMID->data(), &pyramidHeader, sizeof(PyramidHeader));
+                sharedMemoryOUT_PYRAMID->unlock();
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output pyramid." << std::endl;
+                return retCode;
+            }
+        }
+
+        if (!OUT_INTEGRAL.empty()) {
+            const uint32_t ENTRIES{(FINAL_WIDTH + 1) * (FINAL_HEIGHT + 1)};
+            integralHeader.width = FINAL_WIDTH;
+            integralHeader.height = FINAL_HEIGHT;
+            integralHeader.sumOffset = (sizeof(IntegralHeader) + 63u) & ~63u;
+            integralHeader.squaredSumOffset = INTEGRAL_SQUARED ? (integralHeader.sumOffset + ENTRIES * sizeof(uint32_t) + 63u) & ~63u : 0u;
+            const uint32_t SIZE{INTEGRAL_SQUARED ? integralHeader.squaredSumOffset + ENTRIES * static_cast<uint32_t>(sizeof(uint64_t)) : integralHeader.sumOffset + ENTRIES * static_cast<uint32_t>(sizeof(uint32_t))};
+            sharedMemoryOUT_INTEGRAL.reset(new cluon::SharedMemory{OUT_INTEGRAL, SIZE});
+            if (sharedMemoryOUT_INTEGRAL && sharedMemoryOUT_INTEGRAL->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_INTEGRAL << " (" << sharedMemoryOUT_INTEGRAL->size() << " bytes) for an integral image" << (INTEGRAL_SQUARED ? " with squared sums" : "") << " (width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+                sharedMemoryOUT_INTEGRAL->lock();
+                std::memcpy(sharedMemoryOUT_INTEGRAL->data(), &integralHeader, sizeof(IntegralHeader));
+                sharedMemoryOUT_INTEGRAL->unlock();
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output integral image." << std::endl;
+                return retCode;
+            }
+        }
+
+        if (LUT) {
+            if (0.0f >= LUT_GAMMA) {
+                std::cerr << "[i420toolbox]: --lut.gamma must be positive." << std::endl;
+                return retCode;
+            }
+            computeLut(LUT_GAMMA, LUT_CONTRAST, LUT_BRIGHTNESS, LUT_SATURATION, lut);
+            if (!LUT_FILE.empty()) {
+                struct stat status;
+                if ( (0 != stat(LUT_FILE.c_str(), &status)) || !readLut(LUT_FILE, lut) ) {
+                    std::cerr << "[i420toolbox]: Failed to read lookup tables from " << LUT_FILE << " (needs 3 * 256 bytes)." << std::endl;
+                    return retCode;
+                }
+                lutModificationTime = status.st_mtim;
+            }
+        }
+
+        if (!OUT_STATS.empty()) {
+            if ( ((0 == STATS_COLUMNS) != (0 == STATS_ROWS)) || (INNER_WIDTH < STATS_COLUMNS) || (INNER_HEIGHT < STATS_ROWS) || (255 < STATS_CLIP_HIGH) ) {
+                std::cerr << "[i420toolbox]: --stats.columns and --stats.rows must be given both and not exceed the image size and --stats.clip.high must not exceed 255." << std::endl;
+                return retCode;
+            }
+            statsTileSums.resize(STATS_COLUMNS * STATS_ROWS);
+            sharedMemoryOUT_STATS.reset(new cluon::SharedMemory{OUT_STATS, static_cast<uint32_t>(sizeof(StatsHeader) + STATS_COLUMNS * STATS_ROWS * sizeof(float))});
+            if (sharedMemoryOUT_STATS && sharedMemoryOUT_STATS->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_STATS << " (" << sharedMemoryOUT_STATS->size() << " bytes) for image statistics with " << STATS_COLUMNS << "x" << STATS_ROWS << " tiles." << std::endl;
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output statistics." << std::endl;
+                return retCode;
+            }
+        }
+
+        // The masked regions of the current frame are the static ones followed by the ones from the control area.
+        std::vector<MaskRegion> masks;
+        std::vector<MaskRegion> inputMasks;
+        if (MASKS) {
+            if ( (0 != MASK_REGIONS.size() % 4) || ((0 != commandlineArguments.count("mask.mode")) && !MASK_PIXELATE && ("fill" != commandlineArguments["mask.mode"])) ||
+                 (2 > MASK_BLOCK) || (0 != MASK_BLOCK % 2) ) {
+                std::cerr << "[i420toolbox]: --mask needs four values x,y,width,height per region, --mask.mode must be fill or pixelate, and --mask.block must be even." << std::endl;
+                return retCode;
+            }
+            for (uint32_t i{0}; i < MASK_REGIONS.size(); i += 4) {
+                masks.push_back(MaskRegion{static_cast<uint32_t>(MASK_REGIONS[i]), static_cast<uint32_t>(MASK_REGIONS[i + 1]), static_cast<uint32_t>(MASK_REGIONS[i + 2]), static_cast<uint32_t>(MASK_REGIONS[i + 3])});
+            }
+            masks.reserve(masks.size() + MASK_MAX_REGIONS);
+            inputMasks.reserve(masks.capacity());
 
-        const uint32_t TEMP_WIDTH{(0 < SCALE_WIDTH) ? OUT_WIDTH : 0};
-        const uint32_t TEMP_HEIGHT{(0 < SCALE_HEIGHT) ? OUT_HEIGHT : 0};
-        const uint32_t FINAL_WIDTH{(0 < SCALE_WIDTH) ? SCALE_WIDTH : OUT_WIDTH};
-        const uint32_t FINAL_HEIGHT{(0 < SCALE_HEIGHT) ? SCALE_HEIGHT : OUT_HEIGHT};
+            if (!MASK_CONTROL.empty()) {
+                sharedMemoryMASK_CONTROL.reset(new cluon::SharedMemory{MASK_CONTROL, static_cast<uint32_t>(sizeof(MaskControl))});
+                if (sharedMemoryMASK_CONTROL && sharedMemoryMASK_CONTROL->valid()) {
+                    sharedMemoryMASK_CONTROL->lock();
+                    std::memset(sharedMemoryMASK_CONTROL->data(), 0, sharedMemoryMASK_CONTROL->size());
+                    sharedMemoryMASK_CONTROL->unlock();
+                    std::clog << "[i420toolbox]: Created shared memory " << MASK_CONTROL << " (" << sharedMemoryMASK_CONTROL->size() << " bytes) for up to " << MASK_MAX_REGIONS << " masked regions." << std::endl;
+                }
+                else {
+                    std::cerr << "[i420toolbox]: Failed to create shared memory for mask control." << std::endl;
+                    return retCode;
+                }
+            }
+        }
 
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryIN;
-        std::vector<char> inputImageBuffer;
-        std::vector<char> tempImageBuffer;
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_I420;
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryOUT_ARGB;
+        // The glyphs are rendered once at startup so that the text is drawn by copying rows of the atlas.
+        std::vector<uint8_t> glyphAtlas;
+        char overlayText[256];
+        uint64_t frameNumber{0};
+        if (!OVERLAY.empty()) {
+            if ( (1 > OVERLAY_SCALE) || (8 < OVERLAY_SCALE) || (INNER_WIDTH <= OVERLAY_X) || (INNER_HEIGHT <= OVERLAY_Y) ) {
+                std::cerr << "[i420toolbox]: --overlay.scale must be between 1 and 8 and --overlay.x and --overlay.y must be within the output image (without the padding in fit mode)." << std::endl;
+                return retCode;
+            }
+            if (OVERLAY.end() != std::find_if(OVERLAY.begin(), OVERLAY.end(), [](char c) { return 128 <= static_cast<unsigned char>(c); })) {
+                std::clog << "[i420toolbox]: --overlay contains characters outside of ASCII, which are drawn as spaces." << std::endl;
+            }
+            buildGlyphAtlas(OVERLAY_SCALE, glyphAtlas);
+        }
 
-        sharedMemoryIN.reset(new cluon::SharedMemory{IN});
-        if (sharedMemoryIN && sharedMemoryIN->valid()) {
-            std::clog << "[i420toolbox]: Attached to '" << sharedMemoryIN->name() << "' (" << sharedMemoryIN->size() << " bytes)." << std::endl;
-            inputImageBuffer.reserve(sharedMemoryIN->size());
+        if (!OUT_FOREGROUND.empty()) {
+            if ( (0 == FOREGROUND_WIDTH) || (0 == FOREGROUND_HEIGHT) || (255 < FOREGROUND_THRESHOLD) || (0.0f >= FOREGROUND_RATE) || (1.0f < FOREGROUND_RATE) ) {
+                std::cerr << "[i420toolbox]: --foreground.scale must not exceed the image size, --foreground.threshold must not exceed 255, and --foreground.rate must be in (0, 1]." << std::endl;
+                return retCode;
+            }
+            // All buffers for the background model and the blob labeling are allocated once here.
+            const uint32_t PIXELS{FOREGROUND_WIDTH * FOREGROUND_HEIGHT};
+            foregroundFrame.resize(PIXELS);
+            foregroundBackground.resize(PIXELS);
+            foregroundLabels.resize(PIXELS + 1);
+            foregroundParents.resize(PIXELS + 1);
+            foregroundBlobs.resize(PIXELS + 1);
+            sharedMemoryOUT_FOREGROUND.reset(new cluon::SharedMemory{OUT_FOREGROUND, static_cast<uint32_t>(sizeof(ForegroundHeader) + PIXELS)});
+            if (sharedMemoryOUT_FOREGROUND && sharedMemoryOUT_FOREGROUND->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_FOREGROUND << " (" << sharedMemoryOUT_FOREGROUND->size() << " bytes) for a foreground mask (width = " << FOREGROUND_WIDTH << ", height = " << FOREGROUND_HEIGHT << ")." << std::endl;
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output foreground mask." << std::endl;
+                return retCode;
+            }
         }
-        else {
-            std::cerr << "[i420toolbox]: Failed to attach to shared memory '" << IN << "'." << std::endl;
-            return retCode;
+
+        if (!OUT_MOTION.empty()) {
+            if ( (1 > MOTION_RANGE) || (64 < MOTION_RANGE) || (MOTION_BLOCK > INNER_WIDTH) || (MOTION_BLOCK > INNER_HEIGHT) ) {
+                std::cerr << "[i420toolbox]: --motion.range must be between 1 and 64 and the image must hold at least one block of " << MOTION_BLOCK << "x" << MOTION_BLOCK << " pixels." << std::endl;
+                return retCode;
+            }
+            const uint32_t BLOCKS{(INNER_WIDTH / MOTION_BLOCK) * (INNER_HEIGHT / MOTION_BLOCK)};
+            motionPrevious.resize(INNER_WIDTH * INNER_HEIGHT);
+            sharedMemoryOUT_MOTION.reset(new cluon::SharedMemory{OUT_MOTION, static_cast<uint32_t>(sizeof(MotionHeader) + BLOCKS * sizeof(MotionVector))});
+            if (sharedMemoryOUT_MOTION && sharedMemoryOUT_MOTION->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_MOTION << " (" << sharedMemoryOUT_MOTION->size() << " bytes) for motion vectors of " << (INNER_WIDTH / MOTION_BLOCK) << "x" << (INNER_HEIGHT / MOTION_BLOCK) << " blocks." << std::endl;
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output motion vectors." << std::endl;
+                return retCode;
+            }
         }
 
-        if ( 0 < (TEMP_WIDTH * TEMP_HEIGHT) ) {
-            tempImageBuffer.reserve(TEMP_WIDTH * TEMP_HEIGHT * 3/2);
-        } 
+        if (!OUT_TENSOR.empty()) {
+            if ( (3 != TENSOR_MEAN.size()) || (3 != TENSOR_STDDEV.size()) ||
+                 (("float32" != TENSOR_TYPE) && ("float16" != TENSOR_TYPE) && ("int8" != TENSOR_TYPE)) ) {
+                std::cerr << "[i420toolbox]: --tensor.mean and --tensor.std need three values and --tensor.type must be float32, float16, or int8." << std::endl;
+                return retCode;
+            }
+            if ( (0 == TENSOR_BATCH) || (32 < TENSOR_BATCH) || (TENSOR_SLOT >= TENSOR_BATCH) ) {
+                std::cerr << "[i420toolbox]: --tensor.batch must be between 1 and 32 and --tensor.slot smaller than --tensor.batch." << std::endl;
+                return retCode;
+            }
+            tensorHeader.dataType = ("float16" == TENSOR_TYPE) ? TENSOR_FLOAT16 : (("int8" == TENSOR_TYPE) ? TENSOR_INT8 : TENSOR_FLOAT32);
+            tensorHeader.layout = TENSOR_LAYOUT;
+            tensorHeader.batch = TENSOR_BATCH;
+            tensorHeader.channels = 3;
+            tensorHeader.height = FINAL_HEIGHT;
+            tensorHeader.width = FINAL_WIDTH;
+            tensorHeader.dataOffset = (sizeof(TensorHeader) + 63u) & ~63u;
+            tensorHeader.scale = (TENSOR_INT8 == tensorHeader.dataType) ? TENSOR_SCALE : 1.0f;
+            for (uint32_t c{0}; c < 3; c++) {
+                tensorHeader.mean[c] = TENSOR_MEAN[c];
+                tensorHeader.stddev[c] = TENSOR_STDDEV[c];
+            }
 
-        sharedMemoryOUT_I420.reset(new cluon::SharedMemory{OUT, FINAL_WIDTH * FINAL_HEIGHT * 3/2});
-        if (sharedMemoryOUT_I420 && sharedMemoryOUT_I420->valid()) {
-            std::clog << "[i420toolbox]: Created shared memory " << OUT << " (" << sharedMemoryOUT_I420->size() << " bytes) for an I420 image (width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+            // As the input values have only 8 bits, the normalization is precomputed for every possible value.
+            for (uint32_t c{0}; c < 3; c++) {
+                for (uint32_t i{0}; i < 256; i++) {
+                    const float NORMALIZED{(static_cast<float>(i) / 255.0f - TENSOR_MEAN[c]) / TENSOR_STDDEV[c]};
+                    tensorLutFloat32.push_back(NORMALIZED);
+                    tensorLutFloat16.push_back(toFloat16(NORMALIZED));
+                    tensorLutInt8.push_back(static_cast<int8_t>(std::max(-128.0f, std::min(127.0f, std::round(NORMALIZED / TENSOR_SCALE)))));
+                }
+            }
+            tensorRowBuffer.resize(FINAL_WIDTH * 3 * 2);
+
+            const uint32_t BYTES_PER_VALUE{(TENSOR_FLOAT32 == tensorHeader.dataType) ? 4u : ((TENSOR_FLOAT16 == tensorHeader.dataType) ? 2u : 1u)};
+            tensorHeader.bankSize = TENSOR_BATCH * FINAL_WIDTH * FINAL_HEIGHT * 3 * BYTES_PER_VALUE;
+            if (1 < TENSOR_BATCH) {
+                // The first i420toolbox of a batch creates the shared memory area; all others attach to it.
+                sharedMemoryOUT_TENSOR.reset(new cluon::SharedMemory{OUT_TENSOR});
+                if (sharedMemoryOUT_TENSOR && sharedMemoryOUT_TENSOR->valid()) {
+                    sharedMemoryOUT_TENSOR->lock();
+                    const bool MATCHES{(sharedMemoryOUT_TENSOR->size() == tensorHeader.dataOffset + TENSOR_BANKS * tensorHeader.bankSize) &&
+                                       (0 == std::memcmp(sharedMemoryOUT_TENSOR->data(), &tensorHeader, offsetof(TensorHeader, readyBank)))};
+                    sharedMemoryOUT_TENSOR->unlock();
+                    if (!MATCHES) {
+                        std::cerr << "[i420toolbox]: Existing shared memory " << OUT_TENSOR << " does not match the tensor configuration." << std::endl;
+                        return retCode;
+                    }
+                    std::clog << "[i420toolbox]: Attached to '" << sharedMemoryOUT_TENSOR->name() << "' (" << sharedMemoryOUT_TENSOR->size() << " bytes) to fill slot " << TENSOR_SLOT << " of a batched tensor." << std::endl;
+                }
+                else {
+                    sharedMemoryOUT_TENSOR.reset(nullptr);
+                }
+            }
         }
-        else {
-            std::cerr << "[i420toolbox]: Failed to create shared memory for output image (I420)." << std::endl;
-            return retCode;
+        if (!OUT_TENSOR.empty() && !sharedMemoryOUT_TENSOR) {
+            sharedMemoryOUT_TENSOR.reset(new cluon::SharedMemory{OUT_TENSOR, tensorHeader.dataOffset + TENSOR_BANKS * tensorHeader.bankSize});
+            if (sharedMemoryOUT_TENSOR && sharedMemoryOUT_TENSOR->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_TENSOR << " (" << sharedMemoryOUT_TENSOR->size() << " bytes) for a " << TENSOR_TYPE << " tensor (" << ((TENSOR_CHW == TENSOR_LAYOUT) ? "CHW" : "HWC") << ", batch = " << TENSOR_BATCH << ", width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+                sharedMemoryOUT_TENSOR->lock();
+                std::memcpy(sharedMemoryOUT_TENSOR->data(), &tensorHeader, sizeof(TensorHeader));
+                sharedMemoryOUT_TENSOR->unlock();
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output tensor." << std::endl;
+                return retCode;
+            }
+        }
+
+        // Returns the begin of this instance's slot in the given bank.
+        auto tensorSlot = [&](uint32_t bank) {
+            return sharedMemoryOUT_TENSOR->data() + tensorHeader.dataOffset + bank * tensorHeader.bankSize + TENSOR_SLOT * (tensorHeader.bankSize / TENSOR_BATCH);
+        };
+        auto convertToTensor = [&](char *tensor, const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height) {
+            const uint32_t OFFSET{(y0 * FINAL_WIDTH + x0) * ((TENSOR_CHW == TENSOR_LAYOUT) ? 1 : 3)};
+            if (TENSOR_FLOAT32 == tensorHeader.dataType) {
+                i420ToTensor(y, u, v, FINAL_WIDTH, width, height, tensorRowBuffer, tensorLutFloat32, TENSOR_LAYOUT, reinterpret_cast<float*>(tensor) + OFFSET, FINAL_WIDTH, FINAL_HEIGHT);
+            }
+            else if (TENSOR_FLOAT16 == tensorHeader.dataType) {
+                i420ToTensor(y, u, v, FINAL_WIDTH, width, height, tensorRowBuffer, tensorLutFloat16, TENSOR_LAYOUT, reinterpret_cast<uint16_t*>(tensor) + OFFSET, FINAL_WIDTH, FINAL_HEIGHT);
+            }
+            else {
+                i420ToTensor(y, u, v, FINAL_WIDTH, width, height, tensorRowBuffer, tensorLutInt8, TENSOR_LAYOUT, reinterpret_cast<int8_t*>(tensor) + OFFSET, FINAL_WIDTH, FINAL_HEIGHT);
+            }
+        };
+
+        // The padding color in I420 is used for the padding in fit mode and for areas without image content after undistortion.
+        uint8_t paddingYUV[6];
+        {
+            uint8_t padding[2 * 2 * 4];
+            for (uint32_t i{0}; i < 4; i++) {
+                padding[i * 4 + 0] = static_cast<uint8_t>(SCALE_PADDING[2]);
+                padding[i * 4 + 1] = static_cast<uint8_t>(SCALE_PADDING[1]);
+                padding[i * 4 + 2] = static_cast<uint8_t>(SCALE_PADDING[0]);
+                padding[i * 4 + 3] = 255;
+            }
+            libyuv::ARGBToI420(padding, 2 * 4, paddingYUV, 2, paddingYUV + 4, 1, paddingYUV + 5, 1, 2, 2);
         }
 
-        sharedMemoryOUT_ARGB.reset(new cluon::SharedMemory{OUT_ARGB, FINAL_WIDTH * FINAL_HEIGHT * 4});
-        if (sharedMemoryOUT_ARGB && sharedMemoryOUT_ARGB->valid()) {
-            std::clog << "[i420toolbox]: Created shared memory " << OUT_ARGB << " (" << sharedMemoryOUT_ARGB->size() << " bytes) for an ARGB image (width = " << FINAL_WIDTH << ", height = " << FINAL_HEIGHT << ")." << std::endl;
+        // For undistortion and the warp output, the whole input image is needed in I420 (I420 input is used in place) and
+        // remapped from there. The remap tables combine all geometric operations with the lens distortion model.
+        const bool FULL_INPUT{UNDISTORT || !OUT_WARP.empty()};
+        const bool FULL_INPUT_IN_PLACE{std::string{"i420"} == inputFormat->name};
+        std::vector<uint8_t> fullInputBuffer;
+        if (FULL_INPUT && !FULL_INPUT_IN_PLACE) {
+            fullInputBuffer.resize(IN_WIDTH * IN_HEIGHT * 3/2);
         }
-        else {
-            std::cerr << "[i420toolbox]: Failed to create shared memory for output image (ARGB)." << std::endl;
+        uint8_t *fullY{FULL_INPUT_IN_PLACE ? reinterpret_cast<uint8_t*>(inputImageBuffer.data()) : fullInputBuffer.data()};
+        uint8_t *fullU{fullY + IN_WIDTH * IN_HEIGHT};
+        uint8_t *fullV{fullU + ((IN_WIDTH * IN_HEIGHT) >> 2)};
+
+        if ( UNDISTORT && ((4 != UNDISTORT_CAMERA.size()) || (0.0f >= UNDISTORT_CAMERA[0]) || (0.0f >= UNDISTORT_CAMERA[1]) ||
+                           ((4 != UNDISTORT_DISTORTION.size()) && (5 != UNDISTORT_DISTORTION.size()))) ) {
+            std::cerr << "[i420toolbox]: --undistort.camera needs the four values fx,fy,cx,cy and --undistort.distortion the four or five values k1,k2,p1,p2[,k3]." << std::endl;
             return retCode;
         }
+        // Maps a position in the undistorted input image to the corresponding position in the distorted input image
+        // using the Brown-Conrady model with radial (k1, k2, k3) and tangential (p1, p2) distortion.
+        auto distort = [&](float x, float y, float &srcX, float &srcY) {
+            srcX = x;
+            srcY = y;
+            if (UNDISTORT) {
+                const float FX{UNDISTORT_CAMERA[0]};
+                const float FY{UNDISTORT_CAMERA[1]};
+                const float CX{UNDISTORT_CAMERA[2]};
+                const float CY{UNDISTORT_CAMERA[3]};
+                const float K1{UNDISTORT_DISTORTION[0]};
+                const float K2{UNDISTORT_DISTORTION[1]};
+                const float P1{UNDISTORT_DISTORTION[2]};
+                const float P2{UNDISTORT_DISTORTION[3]};
+                const float K3{(5 == UNDISTORT_DISTORTION.size()) ? UNDISTORT_DISTORTION[4] : 0.0f};
+                const float U{(x - CX) / FX};
+                const float V{(y - CY) / FY};
+                const float R2{U * U + V * V};
+                const float RADIAL{1.0f + R2 * (K1 + R2 * (K2 + R2 * K3))};
+                srcX = FX * (U * RADIAL + 2.0f * P1 * U * V + P2 * (R2 + 2.0f * U * U)) + CX;
+                srcY = FY * (V * RADIAL + P1 * (R2 + 2.0f * V * V) + 2.0f * P2 * U * V) + CY;
+            }
+        };
+        // Builds the remap table for the chroma planes from the given mapping for luma positions; a chroma sample is
+        // located in the center of its 2x2 luma pixels.
+        auto buildChromaRemapTable = [&](RemapTable &table, uint32_t width, uint32_t height, const std::function<void(float, float, float&, float&)> &mapping) {
+            buildRemapTable(table, width/2, height/2, REMAP_TILE_SIZE/2, IN_WIDTH/2, IN_HEIGHT/2, IN_WIDTH/2,
+                            [&mapping](float x, float y, float &srcX, float &srcY) {
+                                mapping(2.0f * x + 0.5f, 2.0f * y + 0.5f, srcX, srcY);
+                                srcX = (srcX - 0.5f) / 2.0f;
+                                srcY = (srcY - 0.5f) / 2.0f;
+                            });
+        };
+
+        // Maps a pixel of the inner area through scaling, rotating, mirroring, and cropping to the (distorted) input image.
+        std::function<void(float, float, float&, float&)> innerToInput = [&](float x, float y, float &srcX, float &srcY) {
+            const float OUT_X{(x + 0.5f) * static_cast<float>(OUT_WIDTH) / static_cast<float>(INNER_WIDTH) - 0.5f};
+            const float OUT_Y{(y + 0.5f) * static_cast<float>(OUT_HEIGHT) / static_cast<float>(INNER_HEIGHT) - 0.5f};
+            const float LAST_X{static_cast<float>(CROP_WIDTH - 1)};
+            const float LAST_Y{static_cast<float>(CROP_HEIGHT - 1)};
+            float cropX{OUT_X};
+            float cropY{OUT_Y};
+            if (90 == ROTATE) {
+                cropX = OUT_Y;
+                cropY = LAST_Y - OUT_X;
+            }
+            else if (180 == ROTATE) {
+                cropX = LAST_X - OUT_X;
+                cropY = LAST_Y - OUT_Y;
+            }
+            else if (270 == ROTATE) {
+                cropX = LAST_X - OUT_Y;
+                cropY = OUT_X;
+            }
+            cropY = INVERT ? LAST_Y - cropY : cropY;
+            distort(static_cast<float>(CROP_X) + cropX, static_cast<float>(CROP_Y) + cropY, srcX, srcY);
+        };
+
+        RemapTable undistortTableY;
+        RemapTable undistortTableUV;
+        if (UNDISTORT) {
+            buildRemapTable(undistortTableY, INNER_WIDTH, INNER_HEIGHT, REMAP_TILE_SIZE, IN_WIDTH, IN_HEIGHT, IN_WIDTH, innerToInput);
+            if (!LUMA) {
+                buildChromaRemapTable(undistortTableUV, INNER_WIDTH, INNER_HEIGHT, innerToInput);
+            }
+            std::clog << "[i420toolbox]: Precomputed remap tables for undistortion (" << (undistortTableY.entries.size() + undistortTableUV.entries.size()) * sizeof(RemapEntry) << " bytes)." << std::endl;
+        }
+
+        // The gain map is given for the input image; it is resampled once onto a grid over the inner area, which is
+        // about as coarse as the given map, so that it follows cropping, rotating, mirroring, scaling, and undistortion.
+        GainMap gainMap;
+        std::vector<uint16_t> gainRow;
+        if (FLATFIELD) {
+            uint32_t mapWidth{0};
+            uint32_t mapHeight{0};
+            std::vector<uint16_t> map;
+            if (!readPgm16(FLATFIELD_FILE, mapWidth, mapHeight, map)) {
+                std::cerr << "[i420toolbox]: Failed to read the gain map from " << FLATFIELD_FILE << " (needs a binary PGM file with 16-bit values)." << std::endl;
+                return retCode;
+            }
+            const float STEP{static_cast<float>(std::min(IN_WIDTH / mapWidth, IN_HEIGHT / mapHeight)) * static_cast<float>(INNER_WIDTH) / static_cast<float>(OUT_WIDTH)};
+            gainMap.step = std::max(1u, std::min(GAIN_MAX_STEP, static_cast<uint32_t>(STEP)));
+            gainMap.width = (INNER_WIDTH - 1) / gainMap.step + 2;
+            gainMap.height = (INNER_HEIGHT - 1) / gainMap.step + 2;
+            gainMap.gains.resize(gainMap.width * gainMap.height);
+            for (uint32_t j{0}; j < gainMap.height; j++) {
+                for (uint32_t i{0}; i < gainMap.width; i++) {
+                    float srcX{0};
+                    float srcY{0};
+                    innerToInput(static_cast<float>(i * gainMap.step), static_cast<float>(j * gainMap.step), srcX, srcY);
+                    const float MAP_X{std::max(0.0f, std::min(static_cast<float>(mapWidth - 1), (srcX + 0.5f) * static_cast<float>(mapWidth) / static_cast<float>(IN_WIDTH) - 0.5f))};
+                    const float MAP_Y{std::max(0.0f, std::min(static_cast<float>(mapHeight - 1), (srcY + 0.5f) * static_cast<float>(mapHeight) / static_cast<float>(IN_HEIGHT) - 0.5f))};
+                    const uint32_t X0{std::min(static_cast<uint32_t>(MAP_X), mapWidth - 1)};
+                    const uint32_t Y0{std::min(static_cast<uint32_t>(MAP_Y), mapHeight - 1)};
+                    const uint32_t X1{std::min(X0 + 1, mapWidth - 1)};
+                    const uint32_t Y1{std::min(Y0 + 1, mapHeight - 1)};
+                    const float FX{MAP_X - static_cast<float>(X0)};
+                    const float FY{MAP_Y - static_cast<float>(Y0)};
+                    const float TOP{static_cast<float>(map[Y0 * mapWidth + X0]) * (1.0f - FX) + static_cast<float>(map[Y0 * mapWidth + X1]) * FX};
+                    const float BOTTOM{static_cast<float>(map[Y1 * mapWidth + X0]) * (1.0f - FX) + static_cast<float>(map[Y1 * mapWidth + X1]) * FX};
+                    gainMap.gains[j * gainMap.width + i] = static_cast<uint16_t>(std::lround(TOP * (1.0f - FY) + BOTTOM * FY));
+                }
+            }
+            gainRow.resize(INNER_WIDTH);
+            std::clog << "[i420toolbox]: Loaded gain map " << FLATFIELD_FILE << " (" << mapWidth << "x" << mapHeight << ") as a " << gainMap.width << "x" << gainMap.height << " grid with a step of " << gainMap.step << " pixels." << std::endl;
+        }
+
+        // The history of the temporal filter holds the previous filtered inner area plane by plane.
+        DenoiseRamp denoiseRamp{256, 0};
+        std::vector<uint8_t> denoiseHistory;
+        bool denoiseBypass{true};
+        bool denoiseValid{false};
+        if (DENOISE) {
+            if ( (0.0f > DENOISE_STRENGTH) || (1.0f <= DENOISE_STRENGTH) || (1 > DENOISE_THRESHOLD) || (255 < DENOISE_THRESHOLD) ) {
+                std::cerr << "[i420toolbox]: --denoise needs a strength in [0, 1) and --denoise.threshold a value in [1, 255]." << std::endl;
+                return retCode;
+            }
+            denoiseRamp = computeDenoiseRamp(static_cast<uint32_t>(std::lround((1.0f - DENOISE_STRENGTH) * 256.0f)), DENOISE_THRESHOLD);
+            denoiseHistory.resize(INNER_WIDTH * INNER_HEIGHT * (LUMA ? 2 : 3)/2);
+        }
+
+        RemapTable warpTableY;
+        RemapTable warpTableUV;
+        if (!OUT_WARP.empty()) {
+            // The warp matrix maps input pixels to warp pixels; the remap tables need its inverse.
+            double inverse[9]{};
+            bool invertible{false};
+            if (9 == WARP_MATRIX.size()) {
+                double m[9];
+                for (uint32_t i{0}; i < 9; i++) {
+                    m[i] = static_cast<double>(WARP_MATRIX[i]);
+                }
+                const double DETERMINANT{m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6])};
+                invertible = (1e-12 < std::fabs(DETERMINANT));
+                if (invertible) {
+                    inverse[0] = (m[4] * m[8] - m[5] * m[7]) / DETERMINANT;
+                    inverse[1] = (m[2] * m[7] - m[1] * m[8]) / DETERMINANT;
+                    inverse[2] = (m[1] * m[5] - m[2] * m[4]) / DETERMINANT;
+                    inverse[3] = (m[5] * m[6] - m[3] * m[8]) / DETERMINANT;
+                    inverse[4] = (m[0] * m[8] - m[2] * m[6]) / DETERMINANT;
+                    inverse[5] = (m[2] * m[3] - m[0] * m[5]) / DETERMINANT;
+                    inverse[6] = (m[3] * m[7] - m[4] * m[6]) / DETERMINANT;
+                    inverse[7] = (m[1] * m[6] - m[0] * m[7]) / DETERMINANT;
+                    inverse[8] = (m[0] * m[4] - m[1] * m[3]) / DETERMINANT;
+                }
+            }
+            if (!invertible || (2 > WARP_WIDTH) || (2 > WARP_HEIGHT) || (0 != (WARP_WIDTH | WARP_HEIGHT) % 2)) {
+                std::cerr << "[i420toolbox]: --warp.matrix needs nine values of an invertible 3x3 matrix (row-major) and --warp.width and --warp.height must be even." << std::endl;
+                return retCode;
+            }
+
+            // Maps a pixel of the warp image through the inverse homography to the distorted input image; positions behind
+            // the camera are mapped outside of it.
+            std::function<void(float, float, float&, float&)> warpToInput = [inverse, &distort](float x, float y, float &srcX, float &srcY) {
+                const double W{inverse[6] * x + inverse[7] * y + inverse[8]};
+                srcX = -1.0f;
+                srcY = -1.0f;
+                if (0.0 < W) {
+                    distort(static_cast<float>((inverse[0] * x + inverse[1] * y + inverse[2]) / W),
+                            static_cast<float>((inverse[3] * x + inverse[4] * y + inverse[5]) / W), srcX, srcY);
+                }
+            };
+            buildRemapTable(warpTableY, WARP_WIDTH, WARP_HEIGHT, REMAP_TILE_SIZE, IN_WIDTH, IN_HEIGHT, IN_WIDTH, warpToInput);
+            if (!LUMA) {
+                buildChromaRemapTable(warpTableUV, WARP_WIDTH, WARP_HEIGHT, warpToInput);
+            }
+
+            sharedMemoryOUT_WARP.reset(new cluon::SharedMemory{OUT_WARP, WARP_WIDTH * WARP_HEIGHT * (LUMA ? 2 : 3)/2});
+            if (sharedMemoryOUT_WARP && sharedMemoryOUT_WARP->valid()) {
+                std::clog << "[i420toolbox]: Created shared memory " << OUT_WARP << " (" << sharedMemoryOUT_WARP->size() << " bytes) for a warped " << (LUMA ? "Y" : "I420") << " image (width = " << WARP_WIDTH << ", height = " << WARP_HEIGHT << ")." << std::endl;
+            }
+            else {
+                std::cerr << "[i420toolbox]: Failed to create shared memory for output warp image." << std::endl;
+                return retCode;
+            }
+        }
+
+        if (FIT) {
+            // The padding is written only once as only the inner area is updated per frame.
+            sharedMemoryOUT_I420->lock();
+            if (LUMA) {
+                libyuv::SetPlane(i420Y, FINAL_WIDTH, FINAL_WIDTH, FINAL_HEIGHT, paddingYUV[0]);
+            }
+            else {
+                libyuv::I420Rect(i420Y, FINAL_WIDTH, i420U, FINAL_WIDTH/2, i420V, FINAL_WIDTH/2, 0, 0, FINAL_WIDTH, FINAL_HEIGHT, paddingYUV[0], paddingYUV[4], paddingYUV[5]);
+            }
+            for (auto &output : outputs) {
+                output.sharedMemory->lock();
+                output.format->convert(i420Y, i420U, i420V, FINAL_WIDTH, reinterpret_cast<uint8_t*>(output.sharedMemory->data()), FINAL_WIDTH, FINAL_HEIGHT, 0, 0, FINAL_WIDTH, FINAL_HEIGHT);
+                output.sharedMemory->unlock();
+            }
+            if (sharedMemoryOUT_TENSOR) {
+                sharedMemoryOUT_TENSOR->lock();
+                for (uint32_t bank{0}; bank < TENSOR_BANKS; bank++) {
+                    convertToTensor(tensorSlot(bank), i420Y, i420U, i420V, 0, 0, FINAL_WIDTH, FINAL_HEIGHT);
+                }
+                sharedMemoryOUT_TENSOR->unlock();
+            }
+            sharedMemoryOUT_I420->unlock();
+        }
 
         Display *display{nullptr};
         Visual *visual{nullptr};
         Window window{0};
         XImage *ximage{nullptr};
+        // In luma mode, there is no ARGB image to display; the Y plane is expanded into this buffer instead.
+        std::vector<uint8_t> displayBuffer;
 
         if (VERBOSE) {
+            if (LUMA) {
+                displayBuffer.resize(FINAL_WIDTH * FINAL_HEIGHT * 4);
+            }
             display = XOpenDisplay(NULL);
             visual = DefaultVisual(display, 0);
             window = XCreateSimpleWindow(display, RootWindow(display, 0), 0, 0, FINAL_WIDTH, FINAL_HEIGHT, 1, 0, 0);
-            ximage = XCreateImage(display, visual, 24, ZPixmap, 0, reinterpret_cast<char*>(sharedMemoryOUT_ARGB->data()), FINAL_WIDTH, FINAL_HEIGHT, 32, 0);
+            ximage = XCreateImage(display, visual, 24, ZPixmap, 0, LUMA ? reinterpret_cast<char*>(displayBuffer.data()) : sharedMemoryOUT_ARGB->data(), FINAL_WIDTH, FINAL_HEIGHT, 32, 0);
             XMapWindow(display, window);
         }
 
+        // Crops, rotates, and converts the input image into the given I420 planes.
+        std::vector<uint8_t> rotateBuffer;
+        const bool REORIENT{(0 != ROTATE) || INVERT};
+        if ( ((INPUT_LIBYUV != inputFormat->conversion) || LUMA) && REORIENT ) {
+            rotateBuffer.resize(CONVERTED_WIDTH * CONVERTED_HEIGHT * 3/2);
+        }
+        std::vector<uint8_t> bayerRowBuffer;
+        if (INPUT_BAYER == inputFormat->conversion) {
+            bayerRowBuffer.resize(std::max(CONVERTED_WIDTH, FULL_INPUT ? IN_WIDTH : 0u) * 4 * 2);
+        }
+        auto convertInput = [&](uint8_t *y, uint8_t *u, uint8_t *v, uint32_t stride) {
+            if (INPUT_LIBYUV == inputFormat->conversion) {
+                libyuv::ConvertToI420(reinterpret_cast<uint8_t*>(inputImageBuffer.data()), IN_SIZE,
+                                      y, stride,
+                                      u, stride/2,
+                                      v, stride/2,
+                                      CROP_X, CROP_Y,
+                                      IN_WIDTH, INVERT ? -static_cast<int>(IN_HEIGHT) : static_cast<int>(IN_HEIGHT),
+                                      CROP_WIDTH, CROP_HEIGHT,
+                                      static_cast<libyuv::RotationMode>(ROTATE), IN_FOURCC);
+                return;
+            }
+
+            // All other formats are converted directly into the destination unless they need to be rotated or mirrored afterwards.
+            uint8_t *convertedY{!REORIENT ? y : rotateBuffer.data()};
+            uint8_t *convertedU{!REORIENT ? u : rotateBuffer.data() + CONVERTED_WIDTH * CONVERTED_HEIGHT};
+            uint8_t *convertedV{!REORIENT ? v : rotateBuffer.data() + CONVERTED_WIDTH * CONVERTED_HEIGHT + ((CONVERTED_WIDTH * CONVERTED_HEIGHT) >> 2)};
+            const uint32_t CONVERTED_STRIDE{!REORIENT ? stride : CONVERTED_WIDTH};
+            if (INPUT_16BIT == inputFormat->conversion) {
+                convert16ToI420(reinterpret_cast<uint16_t*>(inputImageBuffer.data()), IN_WIDTH, IN_HEIGHT, inputFormat->semiPlanar, inputFormat->downconversionScale,
+                                CROP_X, CROP_Y, CROP_WIDTH, CROP_HEIGHT,
+                                convertedY, CONVERTED_STRIDE, convertedU, CONVERTED_STRIDE/2, convertedV, CONVERTED_STRIDE/2);
+            }
+            else {
+                bayerToI420(reinterpret_cast<uint8_t*>(inputImageBuffer.data()), IN_WIDTH, IN_HEIGHT, inputFormat->name, BAYER_BINNING,
+                            CROP_X, CROP_Y, CONVERTED_WIDTH * (BAYER_BINNING ? 2 : 1), CONVERTED_HEIGHT * (BAYER_BINNING ? 2 : 1), bayerRowBuffer,
+                            convertedY, CONVERTED_STRIDE, convertedU, CONVERTED_STRIDE/2, convertedV, CONVERTED_STRIDE/2);
+            }
+            if (REORIENT) {
+                // A negative height inverts the image vertically before the rotation.
+                libyuv::I420Rotate(convertedY, CONVERTED_WIDTH, convertedU, CONVERTED_WIDTH/2, convertedV, CONVERTED_WIDTH/2,
+                                   y, stride, u, stride/2, v, stride/2,
+                                   CONVERTED_WIDTH, INVERT ? -static_cast<int>(CONVERTED_HEIGHT) : static_cast<int>(CONVERTED_HEIGHT),
+                                   static_cast<libyuv::RotationMode>(ROTATE));
+            }
+        };
+
+        // Converts the whole input image to I420 for remapping unless it is already in I420.
+        auto convertFullInput = [&]() {
+            if (FULL_INPUT_IN_PLACE) {
+                return;
+            }
+            if (INPUT_LIBYUV == inputFormat->conversion) {
+                libyuv::ConvertToI420(reinterpret_cast<uint8_t*>(inputImageBuffer.data()), IN_SIZE, fullY, IN_WIDTH, fullU, IN_WIDTH/2, fullV, IN_WIDTH/2,
+                                      0, 0, IN_WIDTH, IN_HEIGHT, IN_WIDTH, IN_HEIGHT, libyuv::kRotate0, IN_FOURCC);
+            }
+            else if (INPUT_16BIT == inputFormat->conversion) {
+                convert16ToI420(reinterpret_cast<uint16_t*>(inputImageBuffer.data()), IN_WIDTH, IN_HEIGHT, inputFormat->semiPlanar, inputFormat->downconversionScale,
+                                0, 0, IN_WIDTH, IN_HEIGHT, fullY, IN_WIDTH, fullU, IN_WIDTH/2, fullV, IN_WIDTH/2);
+            }
+            else {
+                bayerToI420(reinterpret_cast<uint8_t*>(inputImageBuffer.data()), IN_WIDTH, IN_HEIGHT, inputFormat->name, false,
+                            0, 0, IN_WIDTH, IN_HEIGHT, bayerRowBuffer, fullY, IN_WIDTH, fullU, IN_WIDTH/2, fullV, IN_WIDTH/2);
+            }
+        };
+
+        // Remaps the whole input image into the inner area of the given I420 planes.
+        auto undistortInput = [&](uint8_t *y, uint8_t *u, uint8_t *v) {
+            remapPlane(fullY, IN_WIDTH, undistortTableY, y, FINAL_WIDTH, paddingYUV[0]);
+            if (!LUMA) {
+                remapPlane(fullU, IN_WIDTH/2, undistortTableUV, u, FINAL_WIDTH/2, paddingYUV[4]);
+                remapPlane(fullV, IN_WIDTH/2, undistortTableUV, v, FINAL_WIDTH/2, paddingYUV[5]);
+            }
+        };
+
+        // Crops, rotates, and extracts only the Y plane of the given input image into the given plane; formats
+        // without a Y plane are fully converted into the given plane and a scratch buffer for the chroma planes.
+        const bool LUMA_VIEW{LUMA && !FULL_INPUT && (LUMA_CONVERTED != inputFormat->luma)};
+        std::vector<uint8_t> lumaChromaBuffer;
+        if (LUMA && !LUMA_VIEW) {
+            lumaChromaBuffer.resize(std::max(TEMP_WIDTH * TEMP_HEIGHT, FINAL_WIDTH * FINAL_HEIGHT) / 2);
+        }
+        auto convertLuma = [&](const uint8_t *src, uint8_t *y, uint32_t stride) {
+            if (!LUMA_VIEW) {
+                convertInput(y, lumaChromaBuffer.data(), lumaChromaBuffer.data() + lumaChromaBuffer.size()/2, stride);
+                return;
+            }
+            if (LUMA_PLANE == inputFormat->luma) {
+                // A negative height inverts the image vertically before the rotation.
+                libyuv::RotatePlane(src + CROP_Y * IN_WIDTH + CROP_X, IN_WIDTH, y, stride,
+                                    CROP_WIDTH, INVERT ? -static_cast<int>(CROP_HEIGHT) : static_cast<int>(CROP_HEIGHT),
+                                    static_cast<libyuv::RotationMode>(ROTATE));
+                return;
+            }
+
+            uint8_t *convertedY{!REORIENT ? y : rotateBuffer.data()};
+            const uint32_t CONVERTED_STRIDE{!REORIENT ? stride : CROP_WIDTH};
+            if (LUMA_PLANE_16BIT == inputFormat->luma) {
+                libyuv::Convert16To8Plane(reinterpret_cast<const uint16_t*>(src) + CROP_Y * IN_WIDTH + CROP_X, IN_WIDTH,
+                                          convertedY, CONVERTED_STRIDE, inputFormat->downconversionScale, CROP_WIDTH, CROP_HEIGHT);
+            }
+            else if (LUMA_YUYV == inputFormat->luma) {
+                libyuv::YUY2ToY(src + (CROP_Y * IN_WIDTH + CROP_X) * 2, IN_WIDTH * 2, convertedY, CONVERTED_STRIDE, CROP_WIDTH, CROP_HEIGHT);
+            }
+            else {
+                libyuv::UYVYToY(src + (CROP_Y * IN_WIDTH + CROP_X) * 2, IN_WIDTH * 2, convertedY, CONVERTED_STRIDE, CROP_WIDTH, CROP_HEIGHT);
+            }
+            if (REORIENT) {
+                libyuv::RotatePlane(convertedY, CROP_WIDTH, y, stride,
+                                    CROP_WIDTH, INVERT ? -static_cast<int>(CROP_HEIGHT) : static_cast<int>(CROP_HEIGHT),
+                                    static_cast<libyuv::RotationMode>(ROTATE));
+            }
+        };
+
+        // Sets the masked regions for the current frame from the command line and the control area.
+        const uint32_t STATIC_MASKS{static_cast<uint32_t>(MASK_REGIONS.size() / 4)};
+        auto updateMasks = [&]() {
+            masks.resize(STATIC_MASKS);
+            if (sharedMemoryMASK_CONTROL) {
+                sharedMemoryMASK_CONTROL->lock();
+                const MaskControl *control{reinterpret_cast<const MaskControl*>(sharedMemoryMASK_CONTROL->data())};
+                masks.insert(masks.end(), control->regions, control->regions + std::min(control->count, MASK_MAX_REGIONS));
+                sharedMemoryMASK_CONTROL->unlock();
+            }
+        };
+
+        // Blacks out or pixelates the given regions in place, clipped to the area of width x height at (left, top)
+        // (i.e., the inner area with --scale.mode=fit so that the padding stays untouched); chroma is skipped for Y images.
+        auto maskImage = [&](uint8_t *y, uint8_t *u, uint8_t *v, uint32_t width, uint32_t left, uint32_t top, uint32_t areaWidth, uint32_t areaHeight, const std::vector<MaskRegion> &regions) {
+            for (const auto &region : regions) {
+                const uint32_t X0{std::min(std::max(region.x, left), left + areaWidth) & ~1u};
+                const uint32_t Y0{std::min(std::max(region.y, top), top + areaHeight) & ~1u};
+                const uint32_t X1{(static_cast<uint32_t>(std::min(static_cast<uint64_t>(region.x) + region.width, static_cast<uint64_t>(left + areaWidth))) + 1) & ~1u};
+                const uint32_t Y1{(static_cast<uint32_t>(std::min(static_cast<uint64_t>(region.y) + region.height, static_cast<uint64_t>(top + areaHeight))) + 1) & ~1u};
+                if ( (X0 >= X1) || (Y0 >= Y1) ) {
+                    continue;
+                }
+                if (MASK_PIXELATE) {
+                    pixelateRegion(y, width, X0, Y0, X1 - X0, Y1 - Y0, MASK_BLOCK);
+                    if (nullptr != u) {
+                        pixelateRegion(u, width/2, X0/2, Y0/2, (X1 - X0)/2, (Y1 - Y0)/2, MASK_BLOCK/2);
+                        pixelateRegion(v, width/2, X0/2, Y0/2, (X1 - X0)/2, (Y1 - Y0)/2, MASK_BLOCK/2);
+                    }
+                }
+                else {
+                    libyuv::SetPlane(y + Y0 * width + X0, width, X1 - X0, Y1 - Y0, 16);
+                    if (nullptr != u) {
+                        libyuv::SetPlane(u + (Y0/2) * (width/2) + X0/2, width/2, (X1 - X0)/2, (Y1 - Y0)/2, 128);
+                        libyuv::SetPlane(v + (Y0/2) * (width/2) + X0/2, width/2, (X1 - X0)/2, (Y1 - Y0)/2, 128);
+                    }
+                }
+            }
+        };
+
+        // Maps the masked regions to bounding boxes in the input image by sampling their borders, so that they can be
+        // applied to the whole input image as well (e.g. for the warp output).
+        auto masksToInput = [&]() {
+            constexpr uint32_t SAMPLES{8};
+            inputMasks.clear();
+            for (const auto &region : masks) {
+                float minX{static_cast<float>(IN_WIDTH)};
+                float minY{static_cast<float>(IN_HEIGHT)};
+                float maxX{-1.0f};
+                float maxY{-1.0f};
+                // The border runs through the centers of the outermost pixels of the region.
+                const float LEFT{static_cast<float>(region.x)};
+                const float TOP{static_cast<float>(region.y)};
+                const float RIGHT{LEFT + static_cast<float>(std::max(region.width, 1u) - 1)};
+                const float BOTTOM{TOP + static_cast<float>(std::max(region.height, 1u) - 1)};
+                for (uint32_t i{0}; i <= SAMPLES; i++) {
+                    const float T{static_cast<float>(i) / static_cast<float>(SAMPLES)};
+                    const float X[4]{LEFT + T * (RIGHT - LEFT), LEFT, LEFT + T * (RIGHT - LEFT), RIGHT};
+                    const float Y[4]{TOP, TOP + T * (BOTTOM - TOP), BOTTOM, TOP + T * (BOTTOM - TOP)};
+                    for (uint32_t k{0}; k < 4; k++) {
+                        float srcX{0};
+                        float srcY{0};
+                        innerToInput(X[k] - static_cast<float>(INNER_X), Y[k] - static_cast<float>(INNER_Y), srcX, srcY);
+                        minX = std::min(minX, srcX);
+                        minY = std::min(minY, srcY);
+                        maxX = std::max(maxX, srcX);
+                        maxY = std::max(maxY, srcY);
+                    }
+                }
+                minX = std::max(0.0f, std::floor(minX));
+                minY = std::max(0.0f, std::floor(minY));
+                if ( (minX <= maxX) && (minY <= maxY) ) {
+                    inputMasks.push_back(MaskRegion{static_cast<uint32_t>(minX), static_cast<uint32_t>(minY),
+                                                    static_cast<uint32_t>(std::ceil(maxX) - minX) + 1, static_cast<uint32_t>(std::ceil(maxY) - minY) + 1});
+                }
+            }
+        };
+
+        bool publishTensor{false};
         cluon::data::TimeStamp sampleTimeStamp;
+
+        // Remaps the whole input image into the warp image.
+        auto buildWarp = [&]() {
+            if (!masks.empty()) {
+                masksToInput();
+                maskImage(fullY, LUMA ? nullptr : fullU, fullV, IN_WIDTH, 0, 0, IN_WIDTH, IN_HEIGHT, inputMasks);
+            }
+            sharedMemoryOUT_WARP->lock();
+            sharedMemoryOUT_WARP->setTimeStamp(sampleTimeStamp);
+            uint8_t *warpY{reinterpret_cast<uint8_t*>(sharedMemoryOUT_WARP->data())};
+            uint8_t *warpU{warpY + WARP_WIDTH * WARP_HEIGHT};
+            uint8_t *warpV{warpU + ((WARP_WIDTH * WARP_HEIGHT) >> 2)};
+            remapPlane(fullY, IN_WIDTH, warpTableY, warpY, WARP_WIDTH, paddingYUV[0]);
+            if (LUT) {
+                applyLut(warpY, WARP_WIDTH, WARP_WIDTH, WARP_HEIGHT, lut);
+            }
+            if (!LUMA) {
+                remapPlane(fullU, IN_WIDTH/2, warpTableUV, warpU, WARP_WIDTH/2, paddingYUV[4]);
+                remapPlane(fullV, IN_WIDTH/2, warpTableUV, warpV, WARP_WIDTH/2, paddingYUV[5]);
+                if (LUT) {
+                    applyLut(warpU, WARP_WIDTH/2, WARP_WIDTH/2, WARP_HEIGHT/2, lut + 256);
+                    applyLut(warpV, WARP_WIDTH/2, WARP_WIDTH/2, WARP_HEIGHT/2, lut + 512);
+                }
+            }
+            sharedMemoryOUT_WARP->unlock();
+        };
+
+        // Copies the output image into level 0 of the pyramid and reduces it to all further levels. The image is
+        // processed in bands whose height is a multiple of 2^(levels - 1) so that each level is reduced from rows of
+        // the previous level that have just been written and are still in the cache.
+        auto buildPyramid = [&]() {
+            sharedMemoryOUT_PYRAMID->lock();
+            sharedMemoryOUT_PYRAMID->setTimeStamp(sampleTimeStamp);
+            uint8_t *pyramid{reinterpret_cast<uint8_t*>(sharedMemoryOUT_PYRAMID->data())};
+            const uint32_t PLANES{(PYRAMID_I420 == pyramidHeader.format) ? 3u : 1u};
+            const uint32_t BAND{16u << (pyramidHeader.levels - 1)};
+            for (uint32_t row{0}; row < FINAL_HEIGHT; row += BAND) {
+                for (uint32_t plane{0}; plane < PLANES; plane++) {
+                    // Chroma planes have half the width and height; they follow the Y plane in every level.
+                    const uint32_t SHIFT{(0 == plane) ? 0u : 1u};
+                    auto planeOf = [&](uint32_t l) {
+                        const PyramidLevel &LEVEL{pyramidHeader.level[l]};
+                        return pyramid + LEVEL.offset + ((0 == plane) ? 0 : LEVEL.width * LEVEL.height + (plane - 1) * ((LEVEL.width * LEVEL.height) >> 2));
+                    };
+                    const uint8_t *src{(0 == plane) ? i420Y : ((1 == plane) ? i420U : i420V)};
+                    const uint32_t STRIDE{FINAL_WIDTH >> SHIFT};
+                    libyuv::CopyPlane(src + (row >> SHIFT) * STRIDE, STRIDE, planeOf(0) + (row >> SHIFT) * STRIDE, STRIDE,
+                                      STRIDE, std::min(BAND, FINAL_HEIGHT - row) >> SHIFT);
+                    for (uint32_t l{1}; l < pyramidHeader.levels; l++) {
+                        const uint32_t PREVIOUS_WIDTH{pyramidHeader.level[l - 1].width >> SHIFT};
+                        const uint32_t WIDTH{pyramidHeader.level[l].width >> SHIFT};
+                        const uint32_t FIRST{(row >> l) >> SHIFT};
+                        const uint32_t LAST{std::min(((row + BAND) >> l) >> SHIFT, pyramidHeader.level[l].height >> SHIFT)};
+                        if (FIRST < LAST) {
+                            libyuv::ScalePlane(planeOf(l - 1) + 2 * FIRST * PREVIOUS_WIDTH, PREVIOUS_WIDTH, 2 * WIDTH, 2 * (LAST - FIRST),
+                                               planeOf(l) + FIRST * WIDTH, WIDTH, WIDTH, LAST - FIRST, libyuv::kFilterBox);
+                        }
+                    }
+                }
+            }
+            sharedMemoryOUT_PYRAMID->unlock();
+        };
+
+        // Computes the integral image of the Y plane while it is still in the cache.
+        auto buildIntegral = [&]() {
+            sharedMemoryOUT_INTEGRAL->lock();
+            sharedMemoryOUT_INTEGRAL->setTimeStamp(sampleTimeStamp);
+            char *integral{sharedMemoryOUT_INTEGRAL->data()};
+            integralImage(i420Y, FINAL_WIDTH, FINAL_WIDTH, FINAL_HEIGHT,
+                          reinterpret_cast<uint32_t*>(integral + integralHeader.sumOffset),
+                          INTEGRAL_SQUARED ? reinterpret_cast<uint64_t*>(integral + integralHeader.squaredSumOffset) : nullptr);
+            sharedMemoryOUT_INTEGRAL->unlock();
+        };
+
+        // Computes the statistics of the Y plane while it is still in the cache; all except the tile means are derived from the histogram.
+        auto buildStats = [&]() {
+            sharedMemoryOUT_STATS->lock();
+            sharedMemoryOUT_STATS->setTimeStamp(sampleTimeStamp);
+            StatsHeader *stats{reinterpret_cast<StatsHeader*>(sharedMemoryOUT_STATS->data())};
+            std::fill(statsTileSums.begin(), statsTileSums.end(), 0u);
+            lumaStatistics(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, STATS_COLUMNS, STATS_ROWS, stats->histogram, statsTileSums.data());
+
+            const float PIXELS{static_cast<float>(INNER_WIDTH * INNER_HEIGHT)};
+            uint64_t sum{0};
+            uint32_t underexposed{0};
+            uint32_t overexposed{0};
+            stats->minimum = 255;
+            stats->maximum = 0;
+            for (uint32_t i{0}; i < 256; i++) {
+                sum += static_cast<uint64_t>(i) * stats->histogram[i];
+                underexposed += (i <= STATS_CLIP_LOW) ? stats->histogram[i] : 0;
+                overexposed += (i >= STATS_CLIP_HIGH) ? stats->histogram[i] : 0;
+                stats->minimum = ((0 != stats->histogram[i]) && (i < stats->minimum)) ? i : stats->minimum;
+                stats->maximum = (0 != stats->histogram[i]) ? i : stats->maximum;
+            }
+            stats->width = INNER_WIDTH;
+            stats->height = INNER_HEIGHT;
+            stats->mean = static_cast<float>(sum) / PIXELS;
+            stats->underexposed = static_cast<float>(underexposed) / PIXELS;
+            stats->overexposed = static_cast<float>(overexposed) / PIXELS;
+            stats->tileColumns = STATS_COLUMNS;
+            stats->tileRows = STATS_ROWS;
+            float *tileMeans{reinterpret_cast<float*>(stats + 1)};
+            for (uint32_t tile{0}; tile < STATS_COLUMNS * STATS_ROWS; tile++) {
+                const uint32_t COLUMN{tile % STATS_COLUMNS};
+                const uint32_t ROW{tile / STATS_COLUMNS};
+                const uint32_t TILE_WIDTH{(COLUMN + 1) * INNER_WIDTH / STATS_COLUMNS - COLUMN * INNER_WIDTH / STATS_COLUMNS};
+                const uint32_t TILE_HEIGHT{(ROW + 1) * INNER_HEIGHT / STATS_ROWS - ROW * INNER_HEIGHT / STATS_ROWS};
+                tileMeans[tile] = static_cast<float>(statsTileSums[tile]) / static_cast<float>(TILE_WIDTH * TILE_HEIGHT);
+            }
+            sharedMemoryOUT_STATS->unlock();
+        };
+
+        // Estimates the motion of the blocks from the previous frame and keeps the current frame for the next one; the
+        // first frame has no motion.
+        auto buildMotion = [&]() {
+            sharedMemoryOUT_MOTION->lock();
+            sharedMemoryOUT_MOTION->setTimeStamp(sampleTimeStamp);
+            MotionHeader *header{reinterpret_cast<MotionHeader*>(sharedMemoryOUT_MOTION->data())};
+            header->columns = INNER_WIDTH / MOTION_BLOCK;
+            header->rows = INNER_HEIGHT / MOTION_BLOCK;
+            header->blockSize = MOTION_BLOCK;
+            header->range = MOTION_RANGE;
+            if (!motionValid) {
+                libyuv::CopyPlane(innerY, FINAL_WIDTH, motionPrevious.data(), INNER_WIDTH, INNER_WIDTH, INNER_HEIGHT);
+                motionValid = true;
+            }
+            estimateMotion(innerY, FINAL_WIDTH, motionPrevious.data(), INNER_WIDTH, INNER_WIDTH, INNER_HEIGHT, static_cast<int32_t>(MOTION_RANGE),
+                           reinterpret_cast<MotionVector*>(sharedMemoryOUT_MOTION->data() + sizeof(MotionHeader)));
+            libyuv::CopyPlane(innerY, FINAL_WIDTH, motionPrevious.data(), INNER_WIDTH, INNER_WIDTH, INNER_HEIGHT);
+            sharedMemoryOUT_MOTION->unlock();
+        };
+
+        // Updates the background model on the reduced Y plane and publishes the foreground mask with the bounding
+        // boxes of its largest blobs; the model starts from the first frame.
+        auto buildForeground = [&]() {
+            const uint32_t PIXELS{FOREGROUND_WIDTH * FOREGROUND_HEIGHT};
+            libyuv::ScalePlane(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, foregroundFrame.data(), FOREGROUND_WIDTH, FOREGROUND_WIDTH, FOREGROUND_HEIGHT, libyuv::kFilterBox);
+            if (!foregroundValid) {
+                for (uint32_t i{0}; i < PIXELS; i++) {
+                    foregroundBackground[i] = static_cast<uint16_t>(foregroundFrame[i] << 8);
+                }
+                foregroundValid = true;
+            }
+
+            sharedMemoryOUT_FOREGROUND->lock();
+            sharedMemoryOUT_FOREGROUND->setTimeStamp(sampleTimeStamp);
+            ForegroundHeader *header{reinterpret_cast<ForegroundHeader*>(sharedMemoryOUT_FOREGROUND->data())};
+            uint8_t *mask{reinterpret_cast<uint8_t*>(sharedMemoryOUT_FOREGROUND->data()) + sizeof(ForegroundHeader)};
+            updateBackground(foregroundFrame.data(), foregroundBackground.data(), mask, PIXELS,
+                             std::max(1, static_cast<int32_t>(std::lround(FOREGROUND_RATE * 256.0f))), static_cast<int32_t>(FOREGROUND_THRESHOLD));
+            const uint32_t BLOBS{findBlobs(mask, FOREGROUND_WIDTH, FOREGROUND_HEIGHT, FOREGROUND_MIN, foregroundLabels.data(), foregroundParents.data(), foregroundBlobs.data())};
+            const uint32_t BOXES{std::min(BLOBS, FOREGROUND_MAX_BOXES)};
+            std::partial_sort(foregroundBlobs.begin(), foregroundBlobs.begin() + BOXES, foregroundBlobs.begin() + BLOBS,
+                              [](const ForegroundBox &a, const ForegroundBox &b) { return a.pixels > b.pixels; });
+            header->width = FOREGROUND_WIDTH;
+            header->height = FOREGROUND_HEIGHT;
+            header->scale = FOREGROUND_SCALE;
+            header->boxCount = BOXES;
+            for (uint32_t i{0}; i < BOXES; i++) {
+                const ForegroundBox &blob{foregroundBlobs[i]};
+                header->boxes[i] = ForegroundBox{INNER_X + blob.x * FOREGROUND_SCALE, INNER_Y + blob.y * FOREGROUND_SCALE,
+                                                 blob.width * FOREGROUND_SCALE, blob.height * FOREGROUND_SCALE, blob.pixels};
+            }
+            sharedMemoryOUT_FOREGROUND->unlock();
+        };
+
+        // Expands the placeholders of the overlay text for the current frame and draws it; the chroma below the text
+        // is set to neutral so that the text is gray on black regardless of the image.
+        auto drawOverlay = [&](uint8_t *y, uint8_t *u, uint8_t *v) {
+            std::size_t length{0};
+            for (const char *c{OVERLAY.c_str()}; ('\0' != *c) && (length + 32 < sizeof(overlayText)); c++) {
+                if ( ('%' == c[0]) && ('t' == c[1]) ) {
+                    const std::time_t SECONDS{static_cast<std::time_t>(sampleTimeStamp.seconds())};
+                    std::tm utc{};
+                    gmtime_r(&SECONDS, &utc);
+                    length += std::strftime(overlayText + length, sizeof(overlayText) - length, "%Y-%m-%d %H:%M:%S", &utc);
+                    length += static_cast<std::size_t>(std::snprintf(overlayText + length, sizeof(overlayText) - length, ".%03d", sampleTimeStamp.microseconds() / 1000));
+                    c++;
+                }
+                else if ( ('%' == c[0]) && ('n' == c[1]) ) {
+                    length += static_cast<std::size_t>(std::snprintf(overlayText + length, sizeof(overlayText) - length, "%llu", static_cast<unsigned long long>(frameNumber)));
+                    c++;
+                }
+                else {
+                    overlayText[length++] = *c;
+                    c += ( ('%' == c[0]) && ('%' == c[1]) ) ? 1 : 0;
+                }
+            }
+            overlayText[length] = '\0';
+
+            // The text is placed and clipped within the inner area, as only that is converted into the other outputs every frame.
+            const uint32_t TEXT_WIDTH{drawText(overlayText, glyphAtlas, OVERLAY_SCALE, y + INNER_Y * FINAL_WIDTH + INNER_X, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, OVERLAY_X, OVERLAY_Y)};
+            if ( (nullptr != u) && (0 < TEXT_WIDTH) ) {
+                const uint32_t X0{(INNER_X + OVERLAY_X) / 2};
+                const uint32_t Y0{(INNER_Y + OVERLAY_Y) / 2};
+                const uint32_t X1{(INNER_X + OVERLAY_X + TEXT_WIDTH + 1) / 2};
+                const uint32_t Y1{(INNER_Y + std::min(OVERLAY_Y + GLYPH_HEIGHT * OVERLAY_SCALE, INNER_HEIGHT) + 1) / 2};
+                libyuv::SetPlane(u + Y0 * (FINAL_WIDTH/2) + X0, FINAL_WIDTH/2, X1 - X0, Y1 - Y0, 128);
+                libyuv::SetPlane(v + Y0 * (FINAL_WIDTH/2) + X0, FINAL_WIDTH/2, X1 - X0, Y1 - Y0, 128);
+            }
+        };
+
+        // Finds the tiles of the HUD layer that changed since the last frame and prepares them for blending.
+        auto updateHud = [&]() {
+            const uint32_t STRIDE{FINAL_WIDTH * 4};
+            sharedMemoryHUD->lock();
+            const uint8_t *hud{reinterpret_cast<const uint8_t*>(sharedMemoryHUD->data())};
+            for (uint32_t tileY{0}; tileY < HUD_ROWS; tileY++) {
+                for (uint32_t tileX{0}; tileX < HUD_COLUMNS; tileX++) {
+                    const uint32_t X{tileX * HUD_TILE_WIDTH};
+                    const uint32_t Y{tileY * HUD_TILE_HEIGHT};
+                    const uint32_t BYTES{std::min(HUD_TILE_WIDTH, INNER_WIDTH - X) * 4};
+                    const uint32_t OFFSET{(INNER_Y + Y) * STRIDE + (INNER_X + X) * 4};
+                    uint8_t &dirty{hudTileDirty[tileY * HUD_COLUMNS + tileX]};
+                    for (uint32_t row{0}; row < std::min(HUD_TILE_HEIGHT, INNER_HEIGHT - Y); row++) {
+                        if ( dirty || (0 != std::memcmp(hudCache.data() + OFFSET + row * STRIDE, hud + OFFSET + row * STRIDE, BYTES)) ) {
+                            std::memcpy(hudCache.data() + OFFSET + row * STRIDE, hud + OFFSET + row * STRIDE, BYTES);
+                            dirty = 1;
+                        }
+                    }
+                }
+            }
+            sharedMemoryHUD->unlock();
+
+            for (uint32_t tileY{0}; tileY < HUD_ROWS; tileY++) {
+                for (uint32_t tileX{0}; tileX < HUD_COLUMNS; tileX++) {
+                    uint8_t &dirty{hudTileDirty[tileY * HUD_COLUMNS + tileX]};
+                    if (!dirty) {
+                        continue;
+                    }
+                    const uint32_t X{INNER_X + tileX * HUD_TILE_WIDTH};
+                    const uint32_t Y{INNER_Y + tileY * HUD_TILE_HEIGHT};
+                    const uint32_t WIDTH{std::min(HUD_TILE_WIDTH, INNER_WIDTH - tileX * HUD_TILE_WIDTH)};
+                    const uint32_t HEIGHT{std::min(HUD_TILE_HEIGHT, INNER_HEIGHT - tileY * HUD_TILE_HEIGHT)};
+                    const uint8_t *argb{hudCache.data() + Y * STRIDE + X * 4};
+                    uint8_t visible{0};
+                    for (uint32_t row{0}; (row < HEIGHT) && !visible; row++) {
+                        for (uint32_t col{0}; col < WIDTH; col++) {
+                            visible |= argb[row * STRIDE + col * 4 + 3];
+                        }
+                    }
+                    hudTileVisible[tileY * HUD_COLUMNS + tileX] = (0 != visible) ? 1 : 0;
+                    if (HUD_I420) {
+                        uint8_t *y{hudPrepared.data()};
+                        uint8_t *u{y + FINAL_WIDTH * FINAL_HEIGHT};
+                        uint8_t *v{u + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2)};
+                        uint8_t *alpha{v + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2)};
+                        libyuv::ARGBToI420(argb, STRIDE, y + Y * FINAL_WIDTH + X, FINAL_WIDTH, u + (Y/2) * (FINAL_WIDTH/2) + X/2, FINAL_WIDTH/2,
+                                           v + (Y/2) * (FINAL_WIDTH/2) + X/2, FINAL_WIDTH/2, WIDTH, HEIGHT);
+                        libyuv::ARGBExtractAlpha(argb, STRIDE, alpha + Y * FINAL_WIDTH + X, FINAL_WIDTH, WIDTH, HEIGHT);
+                    }
+                    else {
+                        libyuv::ARGBAttenuate(argb, STRIDE, hudPrepared.data() + Y * STRIDE + X * 4, STRIDE, WIDTH, HEIGHT);
+                    }
+                    dirty = 0;
+                }
+            }
+        };
+
+        // Blends the visible HUD tiles into the I420 output image.
+        auto blendHudI420 = [&]() {
+            const uint8_t *y{hudPrepared.data()};
+            const uint8_t *u{y + FINAL_WIDTH * FINAL_HEIGHT};
+            const uint8_t *v{u + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2)};
+            const uint8_t *alpha{v + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2)};
+            for (uint32_t tileY{0}; tileY < HUD_ROWS; tileY++) {
+                for (uint32_t tileX{0}; tileX < HUD_COLUMNS; tileX++) {
+                    if (!hudTileVisible[tileY * HUD_COLUMNS + tileX]) {
+                        continue;
+                    }
+                    const uint32_t X{INNER_X + tileX * HUD_TILE_WIDTH};
+                    const uint32_t Y{INNER_Y + tileY * HUD_TILE_HEIGHT};
+                    const uint32_t Y_OFFSET{Y * FINAL_WIDTH + X};
+                    const uint32_t UV_OFFSET{(Y/2) * (FINAL_WIDTH/2) + X/2};
+                    libyuv::I420Blend(y + Y_OFFSET, FINAL_WIDTH, u + UV_OFFSET, FINAL_WIDTH/2, v + UV_OFFSET, FINAL_WIDTH/2,
+                                      i420Y + Y_OFFSET, FINAL_WIDTH, i420U + UV_OFFSET, FINAL_WIDTH/2, i420V + UV_OFFSET, FINAL_WIDTH/2,
+                                      alpha + Y_OFFSET, FINAL_WIDTH,
+                                      i420Y + Y_OFFSET, FINAL_WIDTH, i420U + UV_OFFSET, FINAL_WIDTH/2, i420V + UV_OFFSET, FINAL_WIDTH/2,
+                                      std::min(HUD_TILE_WIDTH, INNER_WIDTH - tileX * HUD_TILE_WIDTH), std::min(HUD_TILE_HEIGHT, INNER_HEIGHT - tileY * HUD_TILE_HEIGHT));
+                }
+            }
+        };
+
+        // Blends the visible HUD tiles of the given row of tiles into the ARGB output image.
+        auto blendHudARGB = [&](uint32_t tileY) {
+            const uint32_t STRIDE{FINAL_WIDTH * 4};
+            uint8_t *argb{reinterpret_cast<uint8_t*>(sharedMemoryOUT_ARGB->data())};
+            for (uint32_t tileX{0}; tileX < HUD_COLUMNS; tileX++) {
+                if (!hudTileVisible[tileY * HUD_COLUMNS + tileX]) {
+                    continue;
+                }
+                const uint32_t OFFSET{(INNER_Y + tileY * HUD_TILE_HEIGHT) * STRIDE + (INNER_X + tileX * HUD_TILE_WIDTH) * 4};
+                libyuv::ARGBBlend(hudPrepared.data() + OFFSET, STRIDE, argb + OFFSET, STRIDE, argb + OFFSET, STRIDE,
+                                  std::min(HUD_TILE_WIDTH, INNER_WIDTH - tileX * HUD_TILE_WIDTH), std::min(HUD_TILE_HEIGHT, INNER_HEIGHT - tileY * HUD_TILE_HEIGHT));
+            }
+        };
+
+        // Filters the inner area temporally unless too many Y values moved since the last frame, in which case the frame is
+        // passed through to avoid ghosting and the history restarts from it.
+        auto denoise = [&]() {
+            const uint32_t AREA{INNER_WIDTH * INNER_HEIGHT};
+            const uint32_t MOVING{countMoving(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, denoiseHistory.data(), DENOISE_THRESHOLD)};
+            const bool BYPASS{!denoiseValid || (static_cast<float>(MOVING) > DENOISE_BYPASS * static_cast<float>(AREA))};
+            if (VERBOSE && denoiseValid && (BYPASS != denoiseBypass)) {
+                std::clog << "[i420toolbox]: Temporal filter " << (BYPASS ? "bypassed" : "enabled") << " (" << MOVING << " of " << AREA << " values moving)." << std::endl;
+            }
+            denoisePlane(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, denoiseHistory.data(), denoiseRamp, BYPASS);
+            if (!LUMA) {
+                denoisePlane(innerU, FINAL_WIDTH/2, INNER_WIDTH/2, INNER_HEIGHT/2, denoiseHistory.data() + AREA, denoiseRamp, BYPASS);
+                denoisePlane(innerV, FINAL_WIDTH/2, INNER_WIDTH/2, INNER_HEIGHT/2, denoiseHistory.data() + AREA + AREA/4, denoiseRamp, BYPASS);
+            }
+            denoiseBypass = BYPASS;
+            denoiseValid = true;
+        };
+
+        // Extracts the Y plane of the given input image into the locked I420 output, or into the buffer for scaling;
+        // this is the only step that reads from the input, so that it can be done while the input is locked.
+        uint8_t *tempY{reinterpret_cast<uint8_t*>(tempImageBuffer.data())};
+        auto extractLuma = [&](const uint8_t *src) {
+            if (UNDISTORT) {
+                undistortInput(innerY, nullptr, nullptr);
+            }
+            else if ( 0 < (TEMP_WIDTH * TEMP_HEIGHT) ) {
+                convertLuma(src, tempY, TEMP_WIDTH);
+            }
+            else {
+                convertLuma(src, i420Y, FINAL_WIDTH);
+            }
+        };
+
+        // Renders the Y plane from extractLuma into the output area, derives all further outputs from it, and unlocks
+        // the I420 output.
+        auto processLuma = [&]() {
+            if ( !UNDISTORT && (0 < (TEMP_WIDTH * TEMP_HEIGHT)) ) {
+                libyuv::ScalePlane(tempY, TEMP_WIDTH, TEMP_WIDTH, TEMP_HEIGHT, innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, libyuv::kFilterNone);
+            }
+            if (DENOISE) {
+                denoise();
+            }
+            if (FLATFIELD) {
+                applyGainMap(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, gainMap, gainRow.data(), LUT ? lut : nullptr);
+            }
+            else if (LUT) {
+                applyLut(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, lut);
+            }
+            if (!masks.empty()) {
+                maskImage(i420Y, nullptr, nullptr, FINAL_WIDTH, INNER_X, INNER_Y, INNER_WIDTH, INNER_HEIGHT, masks);
+            }
+            if (sharedMemoryOUT_PYRAMID) {
+                buildPyramid();
+            }
+            if (sharedMemoryOUT_INTEGRAL) {
+                buildIntegral();
+            }
+            if (sharedMemoryOUT_STATS) {
+                buildStats();
+            }
+            if (sharedMemoryOUT_MOTION) {
+                buildMotion();
+            }
+            if (sharedMemoryOUT_FOREGROUND) {
+                buildForeground();
+            }
+            if (!OVERLAY.empty()) {
+                drawOverlay(i420Y, nullptr, nullptr);
+            }
+            if (VERBOSE) {
+                libyuv::I400ToARGB(i420Y, FINAL_WIDTH, displayBuffer.data(), FINAL_WIDTH * 4, FINAL_WIDTH, FINAL_HEIGHT);
+                XPutImage(display, window, DefaultGC(display, 0), ximage, 0, 0, 0, 0, FINAL_WIDTH, FINAL_HEIGHT);
+            }
+            sharedMemoryOUT_I420->unlock();
+        };
+        // Notifies the consumers of all areas that are derived from the input image next to the output images.
+        auto notifyDerived = [&]() {
+            if (sharedMemoryOUT_PYRAMID) {
+                sharedMemoryOUT_PYRAMID->notifyAll();
+            }
+            if (sharedMemoryOUT_INTEGRAL) {
+                sharedMemoryOUT_INTEGRAL->notifyAll();
+            }
+            if (sharedMemoryOUT_STATS) {
+                sharedMemoryOUT_STATS->notifyAll();
+            }
+            if (sharedMemoryOUT_MOTION) {
+                sharedMemoryOUT_MOTION->notifyAll();
+            }
+            if (sharedMemoryOUT_FOREGROUND) {
+                sharedMemoryOUT_FOREGROUND->notifyAll();
+            }
+            if (sharedMemoryOUT_WARP) {
+                sharedMemoryOUT_WARP->notifyAll();
+            }
+        };
+
         while (!cluon::TerminateHandler::instance().isTerminated) {
             sampleTimeStamp = cluon::time::now();
 
+            if (!LUT_FILE.empty()) {
+                // The lookup tables are reloaded when their file changes; incomplete files are ignored until the next change.
+                struct stat status;
+                if ( (0 == stat(LUT_FILE.c_str(), &status)) &&
+                     ((status.st_mtim.tv_sec != lutModificationTime.tv_sec) || (status.st_mtim.tv_nsec != lutModificationTime.tv_nsec)) ) {
+                    lutModificationTime = status.st_mtim;
+                    if (readLut(LUT_FILE, lut)) {
+                        std::clog << "[i420toolbox]: Reloaded lookup tables from " << LUT_FILE << "." << std::endl;
+                    }
+                    else {
+                        std::cerr << "[i420toolbox]: Ignoring lookup tables from " << LUT_FILE << " (needs 3 * 256 bytes)." << std::endl;
+                    }
+                }
+            }
+
             sharedMemoryIN->wait();
+            frameNumber++;
+            bool skipFrame{false};
+            if (MASKS) {
+                updateMasks();
+            }
+            if (sharedMemoryHUD) {
+                updateHud();
+            }
             sharedMemoryIN->lock();
             {
                 // Read notification timestamp.
                 auto r = sharedMemoryIN->getTimeStamp();
                 sampleTimeStamp = (r.first ? r.second : sampleTimeStamp);
-                std::memcpy(inputImageBuffer.data(), reinterpret_cast<uint8_t*>(sharedMemoryIN->data()), sharedMemoryIN->size());
+                if (GATE) {
+                    // Unchanged frames are neither converted nor published unless the keepalive interval has passed.
+                    sampleLuma(reinterpret_cast<const uint8_t*>(sharedMemoryIN->data()), *inputFormat, IN_WIDTH, IN_HEIGHT, GATE_STEP, gateSamples.data());
+                    const int64_t NOW{cluon::time::toMicroseconds(sampleTimeStamp)};
+                    skipFrame = (0 != gatePublished) && (GATE_KEEPALIVE > NOW - gatePublished) &&
+                                (GATE_THRESHOLD >= largestBlockDifference(gateSamples.data(), gateReference.data(), GATE_COLUMNS, GATE_ROWS));
+                    if (skipFrame) {
+                        gateSkipped++;
+                        gateSkippedInRow++;
+                    }
+                    else {
+                        if (VERBOSE && (0 < gateSkippedInRow)) {
+                            std::clog << "[i420toolbox]: Skipped " << gateSkippedInRow << " unchanged frames (" << gateSkipped << " in total)." << std::endl;
+                        }
+                        gateSkippedInRow = 0;
+                        gatePublished = NOW;
+                        gateSamples.swap(gateReference);
+                    }
+                }
+                if (skipFrame) {
+                    // The frame is dropped right away without copying it.
+                }
+                else if (LUMA_VIEW) {
+                    // The Y plane is read in place from the input as a strided view instead of copying the whole input image
+                    // first; everything else is done by processLuma after the input is unlocked.
+                    sharedMemoryOUT_I420->lock();
+                    sharedMemoryOUT_I420->setTimeStamp(sampleTimeStamp);
+                    extractLuma(reinterpret_cast<uint8_t*>(sharedMemoryIN->data()));
+                }
+                else {
+                    std::memcpy(inputImageBuffer.data(), reinterpret_cast<uint8_t*>(sharedMemoryIN->data()), sharedMemoryIN->size());
+                }
             }
             sharedMemoryIN->unlock();
+            if (skipFrame) {
+                continue;
+            }
+
+            if (FULL_INPUT) {
+                convertFullInput();
+            }
+
+            if (LUMA) {
+                if (!LUMA_VIEW) {
+                    sharedMemoryOUT_I420->lock();
+                    sharedMemoryOUT_I420->setTimeStamp(sampleTimeStamp);
+                    extractLuma(reinterpret_cast<uint8_t*>(inputImageBuffer.data()));
+                }
+                processLuma();
+                if (sharedMemoryOUT_WARP) {
+                    buildWarp();
+                }
+                sharedMemoryOUT_I420->notifyAll();
+                notifyDerived();
+                continue;
+            }
 
             sharedMemoryOUT_I420->lock();
             sharedMemoryOUT_I420->setTimeStamp(sampleTimeStamp);
             {
-                if ( 0 < (TEMP_WIDTH * TEMP_HEIGHT) ) {
+                if (UNDISTORT) {
+                    undistortInput(innerY, innerU, innerV);
+                }
+                else if ( 0 < (TEMP_WIDTH * TEMP_HEIGHT) ) {
                     // If the image shall be scaled, transform the flipping/cropping operation first and then, render the resulting scaled image into the output area.
-                    libyuv::ConvertToI420(reinterpret_cast<uint8_t*>(inputImageBuffer.data()), IN_WIDTH * IN_HEIGHT * 3/2 /* 3/2*IN_WIDTH for I420*/,
-                                          reinterpret_cast<uint8_t*>(tempImageBuffer.data()), TEMP_WIDTH,
-                                          reinterpret_cast<uint8_t*>(tempImageBuffer.data()+(TEMP_WIDTH * TEMP_HEIGHT)), TEMP_WIDTH/2,
-                                          reinterpret_cast<uint8_t*>(tempImageBuffer.data()+(TEMP_WIDTH * TEMP_HEIGHT + ((TEMP_WIDTH * TEMP_HEIGHT) >> 2))), TEMP_WIDTH/2,
-                                          CROP_X, CROP_Y,
-                                          IN_WIDTH, IN_HEIGHT,
-                                          CROP_WIDTH, CROP_HEIGHT,
-                                          static_cast<libyuv::RotationMode>(ROTATE), FOURCC('I', '4', '2', '0'));
+                    convertInput(reinterpret_cast<uint8_t*>(tempImageBuffer.data()),
+                                 reinterpret_cast<uint8_t*>(tempImageBuffer.data()+(TEMP_WIDTH * TEMP_HEIGHT)),
+                                 reinterpret_cast<uint8_t*>(tempImageBuffer.data()+(TEMP_WIDTH * TEMP_HEIGHT + ((TEMP_WIDTH * TEMP_HEIGHT) >> 2))),
+                                 TEMP_WIDTH);
 
                     libyuv::I420Scale(reinterpret_cast<uint8_t*>(tempImageBuffer.data()), TEMP_WIDTH,
                                       reinterpret_cast<uint8_t*>(tempImageBuffer.data()+(TEMP_WIDTH * TEMP_HEIGHT)), TEMP_WIDTH/2,
                                       reinterpret_cast<uint8_t*>(tempImageBuffer.data()+(TEMP_WIDTH * TEMP_HEIGHT + ((TEMP_WIDTH * TEMP_HEIGHT) >> 2))), TEMP_WIDTH/2,
                                       TEMP_WIDTH, TEMP_HEIGHT,
-                                      reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()), FINAL_WIDTH,
-                                      reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()+(FINAL_WIDTH * FINAL_HEIGHT)), FINAL_WIDTH/2,
-                                      reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()+(FINAL_WIDTH * FINAL_HEIGHT + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2))), FINAL_WIDTH/2,
-                                      FINAL_WIDTH, FINAL_HEIGHT,
+                                      innerY, FINAL_WIDTH,
+                                      innerU, FINAL_WIDTH/2,
+                                      innerV, FINAL_WIDTH/2,
+                                      INNER_WIDTH, INNER_HEIGHT,
                                       libyuv::kFilterNone);
                 }
                 else {
-                    libyuv::ConvertToI420(reinterpret_cast<uint8_t*>(inputImageBuffer.data()), IN_WIDTH * IN_HEIGHT * 3/2 /* 3/2*IN_WIDTH for I420*/,
-                                          reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()), FINAL_WIDTH,
-                                          reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()+(FINAL_WIDTH * FINAL_HEIGHT)), FINAL_WIDTH/2,
-                                          reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()+(FINAL_WIDTH * FINAL_HEIGHT + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2))), FINAL_WIDTH/2,
-                                          CROP_X, CROP_Y,
-                                          IN_WIDTH, IN_HEIGHT,
-                                          CROP_WIDTH, CROP_HEIGHT,
-                                          static_cast<libyuv::RotationMode>(ROTATE), FOURCC('I', '4', '2', '0'));
-                }
-
-                sharedMemoryOUT_ARGB->lock();
-                sharedMemoryOUT_ARGB->setTimeStamp(sampleTimeStamp);
+                    convertInput(i420Y, i420U, i420V, FINAL_WIDTH);
+                }
+                if (DENOISE) {
+                    denoise();
+                }
+                // The flat-field correction and the tone adjustment are applied in one pass while the image is still in
+                // the cache, before any output is derived from it.
+                if (FLATFIELD) {
+                    applyGainMap(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, gainMap, gainRow.data(), LUT ? lut : nullptr);
+                }
+                else if (LUT) {
+                    applyLut(innerY, FINAL_WIDTH, INNER_WIDTH, INNER_HEIGHT, lut);
+                }
+                if (LUT) {
+                    applyLut(innerU, FINAL_WIDTH/2, INNER_WIDTH/2, INNER_HEIGHT/2, lut + 256);
+                    applyLut(innerV, FINAL_WIDTH/2, INNER_WIDTH/2, INNER_HEIGHT/2, lut + 512);
+                }
+                // Masked regions are applied before any output is derived from the image so that no consumer sees them.
+                if (!masks.empty()) {
+                    maskImage(i420Y, i420U, i420V, FINAL_WIDTH, INNER_X, INNER_Y, INNER_WIDTH, INNER_HEIGHT, masks);
+                }
+                if (sharedMemoryOUT_PYRAMID) {
+                    buildPyramid();
+                }
+                if (sharedMemoryOUT_INTEGRAL) {
+                    buildIntegral();
+                }
+                if (sharedMemoryOUT_STATS) {
+                    buildStats();
+                }
+                if (sharedMemoryOUT_MOTION) {
+                    buildMotion();
+                }
+                if (sharedMemoryOUT_FOREGROUND) {
+                    buildForeground();
+                }
+                // The overlay is drawn after the analysis outputs above have been derived from the image.
+                if (!OVERLAY.empty()) {
+                    drawOverlay(i420Y, i420U, i420V);
+                }
+                if (sharedMemoryHUD && HUD_I420) {
+                    blendHudI420();
+                }
+
+                for (auto &output : outputs) {
+                    output.sharedMemory->lock();
+                    output.sharedMemory->setTimeStamp(sampleTimeStamp);
+                }
                 {
-                    libyuv::I420ToARGB(reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()), FINAL_WIDTH,
-                                       reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()+(FINAL_WIDTH * FINAL_HEIGHT)), FINAL_WIDTH/2,
-                                       reinterpret_cast<uint8_t*>(sharedMemoryOUT_I420->data()+(FINAL_WIDTH * FINAL_HEIGHT + ((FINAL_WIDTH * FINAL_HEIGHT) >> 2))), FINAL_WIDTH/2,
-                                       reinterpret_cast<uint8_t*>(sharedMemoryOUT_ARGB->data()), FINAL_WIDTH * 4, FINAL_WIDTH, FINAL_HEIGHT);
+                    // All formats are converted band by band so that the I420 source rows are still in the cache for every format.
+                    // The HUD layer is blended into the ARGB rows of a band right after they have been converted.
+                    constexpr uint32_t BAND{HUD_TILE_HEIGHT};
+                    for (uint32_t row{0}; row < INNER_HEIGHT; row += BAND) {
+                        const uint32_t ROWS{std::min(BAND, INNER_HEIGHT - row)};
+                        for (auto &output : outputs) {
+                            output.format->convert(innerY + row * FINAL_WIDTH, innerU + (row/2) * (FINAL_WIDTH/2), innerV + (row/2) * (FINAL_WIDTH/2), FINAL_WIDTH,
+                                                   reinterpret_cast<uint8_t*>(output.sharedMemory->data()), FINAL_WIDTH, FINAL_HEIGHT,
+                                                   INNER_X, INNER_Y + row, INNER_WIDTH, ROWS);
+                        }
+                        if (sharedMemoryHUD && !HUD_I420) {
+                            blendHudARGB(row / BAND);
+                        }
+                    }
 
                     if (VERBOSE) {
                         XPutImage(display, window, DefaultGC(display, 0), ximage, 0, 0, 0, 0, FINAL_WIDTH, FINAL_HEIGHT);
                     }
                 }
-                sharedMemoryOUT_ARGB->unlock();
+                for (auto &output : outputs) {
+                    output.sharedMemory->unlock();
+                }
+
+                if (sharedMemoryOUT_TENSOR) {
+                    sharedMemoryOUT_TENSOR->lock();
+                    if (1 == TENSOR_BATCH) {
+                        convertToTensor(tensorSlot(0), innerY, innerU, innerV, INNER_X, INNER_Y, INNER_WIDTH, INNER_HEIGHT);
+                        publishTensor = true;
+                    }
+                    else {
+                        TensorHeader *header{reinterpret_cast<TensorHeader*>(sharedMemoryOUT_TENSOR->data())};
+                        auto publishBatch = [header]() {
+                            header->readyBank ^= 1u;
+                            header->validSlots = header->filledSlots;
+                            header->filledSlots = 0;
+                            header->cycle++;
+                        };
+                        const int64_t NOW{cluon::time::toMicroseconds(cluon::time::now())};
+                        publishTensor = false;
+                        if ( (0 != header->filledSlots) && (TENSOR_DEADLINE < NOW - header->cycleStart) ) {
+                            // The deadline has passed: Publish the incomplete batch and start the next one with this frame.
+                            publishBatch();
+                            publishTensor = true;
+                        }
+                        if (0 == header->filledSlots) {
+                            header->cycleStart = NOW;
+                        }
+                        convertToTensor(tensorSlot(header->readyBank ^ 1u), innerY, innerU, innerV, INNER_X, INNER_Y, INNER_WIDTH, INNER_HEIGHT);
+                        header->filledSlots |= (1u << TENSOR_SLOT);
+                        if (header->filledSlots == static_cast<uint32_t>((1ull << TENSOR_BATCH) - 1)) {
+                            publishBatch();
+                            publishTensor = true;
+                        }
+                    }
+                    if (publishTensor) {
+                        sharedMemoryOUT_TENSOR->setTimeStamp(sampleTimeStamp);
+                    }
+                    sharedMemoryOUT_TENSOR->unlock();
+                }
             }
             sharedMemoryOUT_I420->unlock();
 
+            // The warp output is built last as masking modifies the whole input image.
+            if (sharedMemoryOUT_WARP) {
+                buildWarp();
+            }
 
             // Notify listeners.
             sharedMemoryOUT_I420->notifyAll();
-            sharedMemoryOUT_ARGB->notifyAll();
+            for (auto &output : outputs) {
+                output.sharedMemory->notifyAll();
+            }
+            if (sharedMemoryOUT_TENSOR && publishTensor) {
+                sharedMemoryOUT_TENSOR->notifyAll();
+            }
+            notifyDerived();
         }
 
+        if (GATE) {
+            std::clog << "[i420toolbox]: Skipped " << gateSkipped << " of " << frameNumber << " frames as unchanged." << std::endl;
+        }
         if (VERBOSE) {
             XCloseDisplay(display);
         }